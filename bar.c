@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/Xft/Xft.h>
+
+#include "plusminus.h"
+
+// Status bar. The bar is an override-redirect window backed by an off-screen
+// pixmap. Segments are laid out right to left in the order they were added;
+// a segment is re-rendered only when its text changes and its text extents
+// are measured only then. Every update reaches the window as one XCopyArea.
+// The bar sits in the top right corner of the primary monitor.
+
+#define BAR_MAX_SEGMENTS 16
+#define BAR_TEXT_SIZE 64
+#define BAR_MARGIN 10
+#define BAR_PADDING 5
+#define BAR_GAP 10
+
+typedef struct {
+	char text[BAR_TEXT_SIZE];
+	int text_width;
+	int x, width;
+	bool highlight;
+	bool dirty;
+} Segment;
+
+static Segment segments[BAR_MAX_SEGMENTS];
+static int segment_count = 0;
+static bool layout_dirty = true;
+
+static int screen;
+static Window root;
+static Window bar;
+static Pixmap pixmap;
+static int pixmap_width;
+static int bar_width;
+static int bar_height;
+static int bar_right;   // Right edge and top of the monitor holding the bar.
+static int bar_top;
+static int bar_limit;   // Widest the bar may grow on that monitor.
+
+static Visual *visual;
+static Colormap colormap;
+static XftDraw *xft_draw;
+static XftFont *xft_font;
+static XftColor text_color;
+static XftColor background_color;
+static XftColor highlight_color;
+
+void bar_init(Window root_window, const char *font_name) {
+	screen = DefaultScreen(dpy);
+	root = root_window;
+	visual = DefaultVisual(dpy, screen);
+	colormap = DefaultColormap(dpy, screen);
+
+	xft_font = XftFontOpenName(dpy, screen, font_name);
+	if (!xft_font) {
+		xft_font = XftFontOpenName(dpy, screen, "monospace-12");
+	}
+
+	// Colors are allocated once for the lifetime of the bar.
+	XRenderColor render_text = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF};
+	XRenderColor render_background = {0, 0, 0, 0xFFFF};
+	XRenderColor render_highlight = {0, 0, 0xFFFF, 0xFFFF};
+	XftColorAllocValue(dpy, visual, colormap, &render_text, &text_color);
+	XftColorAllocValue(dpy, visual, colormap, &render_background, &background_color);
+	XftColorAllocValue(dpy, visual, colormap, &render_highlight, &highlight_color);
+
+	bar_height = xft_font->ascent + xft_font->descent + 2 * BAR_PADDING;
+	pixmap_width = DisplayWidth(dpy, screen);
+	pixmap = XCreatePixmap(dpy, root, pixmap_width, bar_height, DefaultDepth(dpy, screen));
+	xft_draw = XftDrawCreate(dpy, pixmap, visual, colormap);
+
+	// No background so the server never clears the window before we copy.
+	XSetWindowAttributes wa;
+	wa.override_redirect = True;
+	wa.background_pixmap = None;
+	wa.event_mask = ExposureMask;
+	bar_width = 1;
+	bar_right = pixmap_width;
+	bar_top = 0;
+	bar_limit = pixmap_width;
+	bar = XCreateWindow(dpy, root, bar_right - BAR_MARGIN - bar_width, bar_top + BAR_MARGIN, bar_width, bar_height, 0,
+			DefaultDepth(dpy, screen), InputOutput, visual, CWOverrideRedirect | CWBackPixmap | CWEventMask, &wa);
+
+	XMapWindow(dpy, bar);
+	XLowerWindow(dpy, bar);
+}
+
+// Moves the bar to the top right corner of the given monitor.
+void bar_place(const Geometry *monitor) {
+	bar_right = monitor->x + monitor->width;
+	bar_top = monitor->y;
+	bar_limit = monitor->width < pixmap_width ? monitor->width : pixmap_width;
+	layout_dirty = true;
+	bar_render();
+}
+
+Window bar_window(void) {
+	return bar;
+}
+
+int bar_add_segment(bool highlight) {
+	if (segment_count >= BAR_MAX_SEGMENTS) {
+		log_message(stderr, LOG_WARNING, "Status bar is limited to %d segments", BAR_MAX_SEGMENTS);
+		return -1;
+	}
+
+	Segment *s = &segments[segment_count];
+	memset(s, 0, sizeof(*s));
+	s->highlight = highlight;
+	layout_dirty = true;
+	return segment_count++;
+}
+
+void bar_set_segment(int index, const char *text) {
+	if (index < 0 || index >= segment_count) return;
+
+	Segment *s = &segments[index];
+	if (strncmp(s->text, text, sizeof(s->text)) == 0) return;
+
+	snprintf(s->text, sizeof(s->text), "%s", text);
+	s->dirty = true;
+
+	XGlyphInfo extents;
+	XftTextExtentsUtf8(dpy, xft_font, (FcChar8 *)s->text, strlen(s->text), &extents);
+	if (extents.xOff != s->text_width) {
+		s->text_width = extents.xOff;
+		layout_dirty = true;
+	}
+}
+
+static void bar_layout(void) {
+	int total = 0;
+	for (int i = 0; i < segment_count; i++) {
+		Segment *s = &segments[i];
+		s->width = s->text_width > 0 ? s->text_width + 2 * BAR_PADDING : 0;
+		if (s->width > 0) {
+			total += s->width + (total > 0 ? BAR_GAP : 0);
+		}
+	}
+	if (total > bar_limit) total = bar_limit;
+
+	int x = total;
+	for (int i = 0; i < segment_count; i++) {
+		Segment *s = &segments[i];
+		if (s->width == 0) continue;
+		x -= s->width;
+		s->x = x;
+		s->dirty = true;
+		x -= BAR_GAP;
+	}
+
+	bar_width = MAX(1, total);
+	XftDrawRect(xft_draw, &background_color, 0, 0, bar_width, bar_height);
+	XMoveResizeWindow(dpy, bar, bar_right - BAR_MARGIN - bar_width, bar_top + BAR_MARGIN, bar_width, bar_height);
+	layout_dirty = false;
+}
+
+void bar_render(void) {
+	bool relayout = layout_dirty;
+	if (relayout) bar_layout();
+
+	int x0 = bar_width, x1 = 0;
+	for (int i = 0; i < segment_count; i++) {
+		Segment *s = &segments[i];
+		if (!s->dirty) continue;
+		s->dirty = false;
+		if (s->width == 0) continue;
+
+		XftDrawRect(xft_draw, s->highlight ? &highlight_color : &background_color, s->x, 0, s->width, bar_height);
+		XftDrawStringUtf8(xft_draw, &text_color, xft_font, s->x + BAR_PADDING, BAR_PADDING + xft_font->ascent, (FcChar8 *)s->text, strlen(s->text));
+		if (s->x < x0) x0 = s->x;
+		if (s->x + s->width > x1) x1 = s->x + s->width;
+	}
+
+	if (relayout) {
+		x0 = 0;
+		x1 = bar_width;
+	}
+
+	if (x1 > x0) {
+		XCopyArea(dpy, pixmap, bar, DefaultGC(dpy, screen), x0, 0, x1 - x0, bar_height, x0, 0);
+	}
+}
+
+void bar_expose(const XExposeEvent *e) {
+	XCopyArea(dpy, pixmap, bar, DefaultGC(dpy, screen), e->x, e->y, e->width, e->height, e->x, e->y);
+}
+
+void bar_cleanup(void) {
+	XftColorFree(dpy, visual, colormap, &text_color);
+	XftColorFree(dpy, visual, colormap, &background_color);
+	XftColorFree(dpy, visual, colormap, &highlight_color);
+	if (xft_font) XftFontClose(dpy, xft_font);
+	XftDrawDestroy(xft_draw);
+	XFreePixmap(dpy, pixmap);
+	XDestroyWindow(dpy, bar);
+}
@@ -0,0 +1,363 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+
+// Synthetic X client used by `make bench`. It creates a number of windows on
+// the display plusminus is managing and times how long the WM takes to react
+// to common operations. Every result is printed as one JSON object per line so
+// runs of different versions can be compared with ordinary tools.
+//
+// Operations are requested the way a pager would (EWMH client messages) and
+// the drag is driven through XTest, so no keyboard bindings are involved.
+
+#define TIMEOUT_MS 5000
+
+static Display *dpy;
+static Window root;
+static const char *label = "";
+
+static Atom NET_CURRENT_DESKTOP;
+static Atom NET_WM_DESKTOP;
+static Atom NET_CLIENT_LIST;
+
+typedef struct {
+	Window window;
+	unsigned long changes;
+} BenchWindow;
+
+static BenchWindow *windows;
+static int window_count;
+
+static long long now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int compare_ll(const void *a, const void *b) {
+	long long x = *(const long long *)a, y = *(const long long *)b;
+	return (x > y) - (x < y);
+}
+
+static void report(const char *name, long long *samples, int count) {
+	if (count == 0) {
+		printf("{\"label\":\"%s\",\"bench\":\"%s\",\"windows\":%d,\"samples\":0}\n", label, name, window_count);
+		return;
+	}
+
+	long long total = 0;
+	for (int i = 0; i < count; i++) total += samples[i];
+	qsort(samples, count, sizeof(long long), compare_ll);
+
+	printf("{\"label\":\"%s\",\"bench\":\"%s\",\"windows\":%d,\"samples\":%d,"
+			"\"mean_us\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}\n",
+			label, name, window_count, count,
+			total / 1000.0 / count,
+			samples[count / 2] / 1000.0,
+			samples[(count * 99) / 100 < count ? (count * 99) / 100 : count - 1] / 1000.0,
+			samples[count - 1] / 1000.0);
+	fflush(stdout);
+}
+
+static BenchWindow *find_window(Window window) {
+	for (int i = 0; i < window_count; i++) {
+		if (windows[i].window == window) return &windows[i];
+	}
+	return NULL;
+}
+
+// Reads the next event, giving up after TIMEOUT_MS. Map, unmap and configure
+// notifications are counted per window on the way through.
+static bool next_event(XEvent *ev) {
+	long long deadline = now_ns() + TIMEOUT_MS * 1000000LL;
+
+	while (!XPending(dpy)) {
+		int remaining = (int)((deadline - now_ns()) / 1000000LL);
+		if (remaining <= 0) return false;
+
+		struct pollfd fd = { .fd = ConnectionNumber(dpy), .events = POLLIN };
+		poll(&fd, 1, remaining);
+	}
+
+	XNextEvent(dpy, ev);
+
+	if (ev->type == MapNotify || ev->type == UnmapNotify || ev->type == ConfigureNotify) {
+		BenchWindow *w = find_window(ev->xany.window);
+		if (w) w->changes++;
+	}
+	return true;
+}
+
+static void send_message(Window window, Atom type, long data) {
+	XEvent ev = { 0 };
+	ev.xclient.type = ClientMessage;
+	ev.xclient.window = window;
+	ev.xclient.message_type = type;
+	ev.xclient.format = 32;
+	ev.xclient.data.l[0] = data;
+	ev.xclient.data.l[1] = CurrentTime;
+	XSendEvent(dpy, root, False, SubstructureRedirectMask | SubstructureNotifyMask, &ev);
+	XFlush(dpy);
+}
+
+// Waits until the WM publishes _NET_NUMBER_OF_DESKTOPS, which it does only
+// after it has selected the redirect on the root window, so every window
+// mapped from then on is managed.
+static bool wait_for_wm(void) {
+	Atom number_of_desktops = XInternAtom(dpy, "_NET_NUMBER_OF_DESKTOPS", False);
+
+	for (int i = 0; i < TIMEOUT_MS / 10; i++) {
+		Atom type;
+		int format;
+		unsigned long items, after;
+		unsigned char *data = NULL;
+		if (XGetWindowProperty(dpy, root, number_of_desktops, 0, 1, False, XA_CARDINAL, &type, &format, &items, &after, &data) == Success && data) {
+			XFree(data);
+			return true;
+		}
+		nanosleep(&(struct timespec){ .tv_sec = 0, .tv_nsec = 10000000 }, NULL);
+	}
+	return false;
+}
+
+// Maps every window in turn and measures the time until it receives focus.
+static void bench_map_to_focus(void) {
+	long long *samples = calloc(window_count, sizeof(long long));
+	int count = 0;
+
+	for (int i = 0; i < window_count; i++) {
+		Window window = XCreateSimpleWindow(dpy, root, 0, 0, 200, 150, 0, 0, 0xffffff);
+		XSelectInput(dpy, window, FocusChangeMask | StructureNotifyMask);
+		windows[i].window = window;
+		windows[i].changes = 0;
+
+		long long started = now_ns();
+		XMapWindow(dpy, window);
+		XFlush(dpy);
+
+		XEvent ev;
+		while (next_event(&ev)) {
+			if (ev.type == FocusIn && ev.xfocus.window == window) {
+				samples[count++] = now_ns() - started;
+				break;
+			}
+		}
+	}
+
+	report("map_to_focus", samples, count);
+	free(samples);
+}
+
+// Waits until every window has seen at least one more map, unmap or configure
+// notification than it had in `baseline`.
+static bool wait_all_changed(const unsigned long *baseline) {
+	int pending = 0;
+	for (int i = 0; i < window_count; i++) {
+		if (windows[i].changes == baseline[i]) pending++;
+	}
+
+	XEvent ev;
+	while (pending > 0 && next_event(&ev)) {
+		if (ev.type != MapNotify && ev.type != UnmapNotify && ev.type != ConfigureNotify) continue;
+		BenchWindow *w = find_window(ev.xany.window);
+		if (w && w->changes == baseline[w - windows] + 1) pending--;
+	}
+	return pending == 0;
+}
+
+// Switches away from and back to the desktop holding all windows; every
+// switch hides or shows all of them.
+static void bench_switch_desktop(int rounds) {
+	long long *samples = calloc(rounds * 2, sizeof(long long));
+	unsigned long *baseline = calloc(window_count, sizeof(unsigned long));
+	int count = 0;
+
+	for (int round = 0; round < rounds; round++) {
+		for (long desktop = 2; desktop >= 1; desktop--) {
+			for (int i = 0; i < window_count; i++) baseline[i] = windows[i].changes;
+
+			long long started = now_ns();
+			send_message(root, NET_CURRENT_DESKTOP, desktop);
+			if (wait_all_changed(baseline)) samples[count++] = now_ns() - started;
+		}
+	}
+
+	report("switch_desktop", samples, count);
+	free(baseline);
+	free(samples);
+}
+
+// Sends each window to another desktop and back, one at a time.
+static void bench_move_to_desktop(void) {
+	long long *samples = calloc(window_count * 2, sizeof(long long));
+	int count = 0;
+
+	for (long desktop = 3; desktop >= 1; desktop -= 2) {
+		for (int i = 0; i < window_count; i++) {
+			unsigned long baseline = windows[i].changes;
+
+			long long started = now_ns();
+			send_message(windows[i].window, NET_WM_DESKTOP, desktop);
+
+			XEvent ev;
+			while (windows[i].changes == baseline && next_event(&ev));
+			if (windows[i].changes != baseline) samples[count++] = now_ns() - started;
+		}
+	}
+
+	report("move_to_desktop", samples, count);
+	free(samples);
+}
+
+// Drags the most recently mapped window across the screen with MOD+Button1
+// and measures how many configures reach it and when it settles.
+static void bench_drag(KeySym modifier, int steps) {
+	if (window_count == 0) return;
+
+	int event_base, error_base, major, minor;
+	if (!XTestQueryExtension(dpy, &event_base, &error_base, &major, &minor)) {
+		fprintf(stderr, "XTest is not available, skipping drag benchmark\n");
+		return;
+	}
+
+	BenchWindow *w = &windows[window_count - 1];
+
+	Window unused_root;
+	int x, y;
+	unsigned int window_width, window_height, border, depth;
+	XGetGeometry(dpy, w->window, &unused_root, &x, &y, &window_width, &window_height, &border, &depth);
+
+	KeyCode key = XKeysymToKeycode(dpy, modifier);
+	int dx = DisplayWidth(dpy, DefaultScreen(dpy)) / 4;
+	int dy = DisplayHeight(dpy, DefaultScreen(dpy)) / 4;
+	int pointer_x = x + (int)window_width / 2, pointer_y = y + (int)window_height / 2;
+
+	XTestFakeMotionEvent(dpy, -1, pointer_x, pointer_y, CurrentTime);
+	XTestFakeKeyEvent(dpy, key, True, CurrentTime);
+	XTestFakeButtonEvent(dpy, 1, True, CurrentTime);
+	XSync(dpy, False);
+
+	unsigned long baseline = w->changes;
+	long long started = now_ns();
+	for (int i = 1; i <= steps; i++) {
+		XTestFakeMotionEvent(dpy, -1, pointer_x + dx * i / steps, pointer_y + dy * i / steps, CurrentTime);
+		XFlush(dpy);
+	}
+	long long sent = now_ns();
+
+	XTestFakeButtonEvent(dpy, 1, False, CurrentTime);
+	XTestFakeKeyEvent(dpy, key, False, CurrentTime);
+	XFlush(dpy);
+
+	// The window has settled once it reaches the final pointer offset.
+	int target_x = x + dx, target_y = y + dy;
+	long long settled = 0;
+	XEvent ev;
+	while (next_event(&ev)) {
+		if (ev.type == ConfigureNotify && ev.xconfigure.window == w->window &&
+				ev.xconfigure.x == target_x && ev.xconfigure.y == target_y) {
+			settled = now_ns();
+			break;
+		}
+	}
+
+	printf("{\"label\":\"%s\",\"bench\":\"drag\",\"windows\":%d,\"motions\":%d,\"configures\":%lu,"
+			"\"send_ms\":%.2f,\"settle_ms\":%.2f,\"settled\":%s}\n",
+			label, window_count, steps, w->changes - baseline,
+			(sent - started) / 1000000.0,
+			settled ? (settled - started) / 1000000.0 : -1.0,
+			settled ? "true" : "false");
+	fflush(stdout);
+}
+
+// Destroys every window and measures the time until the WM has removed it
+// from _NET_CLIENT_LIST.
+static void bench_destroy(void) {
+	long long *samples = calloc(window_count, sizeof(long long));
+	int count = 0;
+
+	XSelectInput(dpy, root, PropertyChangeMask);
+
+	for (int i = 0; i < window_count; i++) {
+		long long started = now_ns();
+		XDestroyWindow(dpy, windows[i].window);
+		XFlush(dpy);
+
+		XEvent ev;
+		while (next_event(&ev)) {
+			if (ev.type == PropertyNotify && ev.xproperty.window == root && ev.xproperty.atom == NET_CLIENT_LIST) {
+				samples[count++] = now_ns() - started;
+				break;
+			}
+		}
+		windows[i].window = None;
+	}
+
+	report("destroy_cleanup", samples, count);
+	free(samples);
+}
+
+static void usage(const char *program) {
+	fprintf(stderr, "usage: %s [-n windows] [-r rounds] [-s drag steps] [-m modifier keysym] [-l label]\n", program);
+}
+
+int main(int argc, char **argv) {
+	int rounds = 10;
+	int steps = 500;
+	KeySym modifier = XK_Super_L;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:r:s:m:l:")) != -1) {
+		switch (opt) {
+			case 'n': window_count = atoi(optarg); break;
+			case 'r': rounds = atoi(optarg); break;
+			case 's': steps = atoi(optarg); break;
+			case 'm': modifier = XStringToKeysym(optarg); break;
+			case 'l': label = optarg; break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (window_count <= 0) window_count = 10;
+	if (modifier == NoSymbol) {
+		fprintf(stderr, "unknown modifier keysym\n");
+		return 1;
+	}
+
+	dpy = XOpenDisplay(NULL);
+	if (!dpy) {
+		fprintf(stderr, "cannot open display\n");
+		return 1;
+	}
+	root = DefaultRootWindow(dpy);
+
+	NET_CURRENT_DESKTOP = XInternAtom(dpy, "_NET_CURRENT_DESKTOP", False);
+	NET_WM_DESKTOP = XInternAtom(dpy, "_NET_WM_DESKTOP", False);
+	NET_CLIENT_LIST = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
+
+	if (!wait_for_wm()) {
+		fprintf(stderr, "no window manager answered on this display\n");
+		return 1;
+	}
+
+	windows = calloc(window_count, sizeof(BenchWindow));
+	if (!windows) return 1;
+
+	bench_map_to_focus();
+	bench_switch_desktop(rounds);
+	bench_move_to_desktop();
+	bench_drag(modifier, steps);
+	bench_destroy();
+
+	free(windows);
+	XCloseDisplay(dpy);
+	return 0;
+}
@@ -0,0 +1,43 @@
+#!/bin/sh
+# Runs the benchmark client against plusminus on a private Xvfb display and
+# appends the results to a JSON lines file.
+#
+# usage: bench/run.sh <display number> <output file> <window counts...>
+
+set -eu
+
+number="$1"
+display=":$number"
+output="$2"
+shift 2
+
+label=$(git describe --always --dirty 2>/dev/null || echo unknown)
+
+Xvfb "$display" -screen 0 1920x1080x24 -nolisten tcp >/dev/null 2>&1 &
+xvfb=$!
+wm=
+trap 'kill $wm $xvfb 2>/dev/null || true' EXIT INT TERM
+
+# Wait for the server to accept connections. The socket file alone proves
+# nothing, one left behind by an earlier run looks the same.
+ready=
+for _ in $(seq 50); do
+	kill -0 $xvfb 2>/dev/null || break
+	if xdpyinfo -display "$display" >/dev/null 2>&1; then
+		ready=1
+		break
+	fi
+	sleep 0.1
+done
+
+if [ -z "$ready" ]; then
+	echo "Xvfb on $display did not start" >&2
+	exit 1
+fi
+
+DISPLAY="$display" ./plusminus >bench/plusminus.log 2>&1 &
+wm=$!
+
+for count in "$@"; do
+	DISPLAY="$display" ./bench/bench -n "$count" -l "$label" | tee -a "$output"
+done
@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+
+#include "plusminus.h"
+
+// Client registry. Clients live in a hash table keyed by window id for O(1)
+// lookups and in a doubly linked list that keeps them in mapping order, which
+// is the order _NET_CLIENT_LIST is published in. Each client is also a member
+// of exactly one desktop list; list 0 holds the sticky clients. A third list
+// keeps clients in most recently focused order for window cycling.
+
+#define CLIENT_TABLE_INITIAL_SIZE 64
+
+static Client **table = NULL;
+static unsigned long table_size = 0;
+static unsigned long client_count = 0;
+
+static Client *clients_head = NULL;
+static Client *clients_tail = NULL;
+
+static Client *mru_head = NULL;
+static Client *mru_tail = NULL;
+
+static Client **desktop_heads = NULL;
+static Client **desktop_tails = NULL;
+
+static Window *publish_buffer = NULL;
+static unsigned long publish_capacity = 0;
+
+static Window root;
+static Atom _NET_CLIENT_LIST;
+
+static unsigned long hash_window(Window window) {
+	unsigned long h = (unsigned long)window;
+	h ^= h >> 16;
+	h *= 0x45d9f3bUL;
+	h ^= h >> 16;
+	return h;
+}
+
+static void table_insert(Client **buckets, unsigned long size, Client *c) {
+	unsigned long index = hash_window(c->window) & (size - 1);
+	c->hash_next = buckets[index];
+	buckets[index] = c;
+}
+
+static unsigned long desktop_slot(const Client *c) {
+	return c->sticky ? 0 : c->desktop;
+}
+
+static void desktop_link(Client *c) {
+	unsigned long slot = desktop_slot(c);
+	c->desktop_next = NULL;
+	c->desktop_prev = desktop_tails[slot];
+	if (desktop_tails[slot]) {
+		desktop_tails[slot]->desktop_next = c;
+	} else {
+		desktop_heads[slot] = c;
+	}
+	desktop_tails[slot] = c;
+}
+
+static void desktop_unlink(Client *c) {
+	unsigned long slot = desktop_slot(c);
+	if (c->desktop_prev) c->desktop_prev->desktop_next = c->desktop_next;
+	else desktop_heads[slot] = c->desktop_next;
+	if (c->desktop_next) c->desktop_next->desktop_prev = c->desktop_prev;
+	else desktop_tails[slot] = c->desktop_prev;
+	c->desktop_next = c->desktop_prev = NULL;
+}
+
+static void mru_unlink(Client *c) {
+	if (c->mru_prev) c->mru_prev->mru_next = c->mru_next;
+	else if (mru_head == c) mru_head = c->mru_next;
+	if (c->mru_next) c->mru_next->mru_prev = c->mru_prev;
+	else if (mru_tail == c) mru_tail = c->mru_prev;
+	c->mru_next = c->mru_prev = NULL;
+}
+
+static void table_grow(void) {
+	unsigned long new_size = table_size * 2;
+	Client **new_table = calloc(new_size, sizeof(Client *));
+	if (!new_table) {
+		log_message(stderr, LOG_ERROR, "Failed to grow client table to %lu buckets", new_size);
+		return;
+	}
+
+	for (Client *c = clients_head; c; c = c->next) {
+		table_insert(new_table, new_size, c);
+	}
+
+	free(table);
+	table = new_table;
+	table_size = new_size;
+	log_message(stdout, LOG_DEBUG, "Client table grown to %lu buckets", table_size);
+}
+
+void client_init(Window root_window, Atom client_list_atom) {
+	root = root_window;
+	_NET_CLIENT_LIST = client_list_atom;
+
+	table_size = CLIENT_TABLE_INITIAL_SIZE;
+	table = calloc(table_size, sizeof(Client *));
+	desktop_heads = calloc(number_of_desktops + 1, sizeof(Client *));
+	desktop_tails = calloc(number_of_desktops + 1, sizeof(Client *));
+	if (!table || !desktop_heads || !desktop_tails) {
+		log_message(stderr, LOG_ERROR, "Failed to allocate client table");
+		exit(1);
+	}
+
+	// Anything left over from a previous window manager is stale, the
+	// windows adopted at startup are appended again as they are added.
+	client_publish_list();
+}
+
+Client *client_find(Window window) {
+	if (window == None || !table) return NULL;
+
+	unsigned long index = hash_window(window) & (table_size - 1);
+	for (Client *c = table[index]; c; c = c->hash_next) {
+		if (c->window == window) return c;
+	}
+
+	return NULL;
+}
+
+Client *client_add(Window window) {
+	Client *c = client_find(window);
+	if (c) return c;
+
+	c = calloc(1, sizeof(Client));
+	if (!c) {
+		log_message(stderr, LOG_ERROR, "Failed to allocate client for window 0x%lx", window);
+		return NULL;
+	}
+
+	c->window = window;
+	c->desktop = current_desktop;
+	c->alive = true;
+
+	if (client_count + 1 > table_size - table_size / 4) {
+		table_grow();
+	}
+
+	table_insert(table, table_size, c);
+
+	c->prev = clients_tail;
+	if (clients_tail) {
+		clients_tail->next = c;
+	} else {
+		clients_head = c;
+	}
+	clients_tail = c;
+	client_count++;
+
+	desktop_link(c);
+	spatial_invalidate(c);
+
+	// Until it is focused a new client is the least recently used.
+	c->mru_prev = mru_tail;
+	if (mru_tail) {
+		mru_tail->mru_next = c;
+	} else {
+		mru_head = c;
+	}
+	mru_tail = c;
+
+	// New clients go to the end of the list, so appending is enough.
+	XChangeProperty(dpy, root, _NET_CLIENT_LIST, XA_WINDOW, 32, PropModeAppend, (unsigned char *)&window, 1);
+
+	log_message(stdout, LOG_DEBUG, "Client 0x%lx added to registry (%lu clients)", window, client_count);
+	return c;
+}
+
+void client_remove(Window window) {
+	if (window == None || !table) return;
+
+	unsigned long index = hash_window(window) & (table_size - 1);
+	Client **link = &table[index];
+	while (*link && (*link)->window != window) {
+		link = &(*link)->hash_next;
+	}
+
+	Client *c = *link;
+	if (!c) return;
+	*link = c->hash_next;
+
+	if (c->prev) c->prev->next = c->next;
+	else clients_head = c->next;
+	if (c->next) c->next->prev = c->prev;
+	else clients_tail = c->prev;
+	client_count--;
+
+	desktop_unlink(c);
+	mru_unlink(c);
+	spatial_invalidate(c);
+
+	free(c);
+	client_publish_list();
+
+	log_message(stdout, LOG_DEBUG, "Client 0x%lx removed from registry (%lu clients)", window, client_count);
+}
+
+void client_set_desktop(Client *c, unsigned long desktop) {
+	if (desktop > number_of_desktops) {
+		log_message(stderr, LOG_WARNING, "Ignoring invalid desktop %lu for window 0x%lx", desktop, c->window);
+		return;
+	}
+
+	desktop_unlink(c);
+	if (desktop == 0) {
+		c->sticky = true;
+	} else {
+		c->sticky = false;
+		c->desktop = desktop;
+	}
+	desktop_link(c);
+	spatial_invalidate(c);
+}
+
+Client *client_desktop_first(unsigned long desktop) {
+	if (desktop > number_of_desktops) return NULL;
+	return desktop_heads[desktop];
+}
+
+// Moves a client to the front of the focus order.
+void client_mru_touch(Client *c) {
+	if (mru_head == c) return;
+
+	mru_unlink(c);
+	c->mru_next = mru_head;
+	if (mru_head) mru_head->mru_prev = c;
+	mru_head = c;
+	if (!mru_tail) mru_tail = c;
+}
+
+Client *client_mru_first(void) {
+	return mru_head;
+}
+
+Client *client_first(void) {
+	return clients_head;
+}
+
+unsigned long client_total(void) {
+	return client_count;
+}
+
+void client_publish_list(void) {
+	if (client_count > publish_capacity) {
+		unsigned long capacity = MAX(client_count, publish_capacity * 2);
+		Window *buffer = realloc(publish_buffer, capacity * sizeof(Window));
+		if (!buffer) {
+			log_message(stderr, LOG_ERROR, "Failed to grow client list buffer to %lu entries", capacity);
+			return;
+		}
+		publish_buffer = buffer;
+		publish_capacity = capacity;
+	}
+
+	unsigned long n = 0;
+	for (Client *c = clients_head; c; c = c->next) {
+		publish_buffer[n++] = c->window;
+	}
+
+	XChangeProperty(dpy, root, _NET_CLIENT_LIST, XA_WINDOW, 32, PropModeReplace, (unsigned char *)publish_buffer, n);
+}
+
+// Geometry cache. The WM updates the cache as soon as it issues a configure
+// request and remembers the request serial, so ConfigureNotify events that were
+// generated before that request are recognised as stale and ignored.
+
+void client_set_geometry(Client *c, int x, int y, int width, int height, int border_width) {
+	c->x = x;
+	c->y = y;
+	c->width = width;
+	c->height = height;
+	c->border_width = border_width;
+	spatial_invalidate(c);
+}
+
+void client_configure_notify(const XConfigureEvent *e) {
+	Client *c = client_find(e->window);
+	if (!c) return;
+
+	if ((long)(e->serial - c->configure_serial) < 0) {
+		log_message(stdout, LOG_DEBUG, "Ignoring stale ConfigureNotify for 0x%lx (serial %lu < %lu)", e->window, e->serial, c->configure_serial);
+		return;
+	}
+
+	// A parked client keeps its on-screen position in the cache.
+	if (c->parked) {
+		client_set_geometry(c, c->x, c->y, e->width, e->height, e->border_width);
+	} else {
+		client_set_geometry(c, e->x, e->y, e->width, e->height, e->border_width);
+	}
+}
+
+void client_move(Client *c, int x, int y) {
+	c->configure_serial = NextRequest(dpy);
+	c->x = x;
+	c->y = y;
+	spatial_invalidate(c);
+	XMoveWindow(dpy, c->window, c->parked ? PARKED_X : x, y);
+}
+
+void client_resize(Client *c, int width, int height) {
+	c->configure_serial = NextRequest(dpy);
+	c->width = width;
+	c->height = height;
+	spatial_invalidate(c);
+	XResizeWindow(dpy, c->window, width, height);
+}
+
+void client_move_resize(Client *c, int x, int y, int width, int height) {
+	c->configure_serial = NextRequest(dpy);
+	c->x = x;
+	c->y = y;
+	c->width = width;
+	c->height = height;
+	spatial_invalidate(c);
+	XMoveResizeWindow(dpy, c->window, c->parked ? PARKED_X : x, y, width, height);
+}
+
+void client_set_border_width(Client *c, int border_width) {
+	c->configure_serial = NextRequest(dpy);
+	c->border_width = border_width;
+	spatial_invalidate(c);
+	XSetWindowBorderWidth(dpy, c->window, border_width);
+}
@@ -12,6 +12,20 @@ static const char *sticky_active_border_color = "violet";
 static const char *sticky_inactive_border_color = "cyan";
 static const char *time_format = "%A %d.%m.%Y %H:%M:%S";
 static bool follow_focus = false;
+static int desktop_switch_mode = SWITCH_UNMAP; // SWITCH_UNMAP or SWITCH_PARK (keep windows mapped off-screen)
+static unsigned int drag_rate = 60;            // Max configures per second while dragging, 0 = unlimited
+static bool wireframe_drag = false;            // Drag an outline and configure the window only on release
+static bool key_repeat_acceleration = false;   // Speed up keyboard move/resize while the key is held
+static Layout default_layout = LAYOUT_FLOATING; // LAYOUT_FLOATING, LAYOUT_MASTER_STACK or LAYOUT_GRID
+static int master_size = 55;                   // Master area width in percent of the screen
+static int snap_distance = 10;                 // Dragged windows stick to edges this close, 0 = off
+
+static const Widget widgets[] = {
+	/* Function             Interval (s, 0 = default) */
+	{ widget_memory,        5 },
+	{ widget_cpu,           2 },
+	{ widget_time,          0 },  // Every second if time_format shows seconds, else every minute.
+};
 
 static Shortcut shortcuts[] = {
 	/* Mask                 KeySym                    Shell command                                         */
@@ -58,4 +72,15 @@ static Keybinds keybinds[] = {
 	{ MODKEY | ControlMask, XK_Left,    window_snap_left,    { 0 }        },
 	{ MODKEY,               XK_q,       kill_window,         { 0 }        },
 	{ MODKEY,               XK_s,       sticky,              { 0 }        },
+	{ MODKEY,               XK_t,       set_layout,          { .i = LAYOUT_MASTER_STACK } },
+	{ MODKEY,               XK_g,       set_layout,          { .i = LAYOUT_GRID }         },
+	{ MODKEY | ShiftMask,   XK_f,       set_layout,          { .i = LAYOUT_FLOATING }     },
+	{ MODKEY,               XK_h,       focus_direction,     { .i = DIRECTION_LEFT }      },
+	{ MODKEY,               XK_j,       focus_direction,     { .i = DIRECTION_DOWN }      },
+	{ MODKEY,               XK_k,       focus_direction,     { .i = DIRECTION_UP }        },
+	{ MODKEY,               XK_l,       focus_direction,     { .i = DIRECTION_RIGHT }     },
+	{ Mod1Mask,             XK_Tab,     cycle_windows,       { .i = +1 }  },
+	{ Mod1Mask | ShiftMask, XK_Tab,     cycle_windows,       { .i = -1 }  },
+	{ MODKEY,               XK_Tab,     cycle_desktops,      { .i = +1 }  },
+	{ MODKEY | ShiftMask,   XK_Tab,     cycle_desktops,      { .i = -1 }  },
 };
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <X11/XKBlib.h>
+
+#include "plusminus.h"
+
+// Alt-tab style cycling. The first press of a cycling binding grabs the
+// keyboard and takes a snapshot of the windows on the current desktop (or of
+// the desktops) in most recently used order; every further press previews the
+// next entry and releasing the binding's modifier commits it. Escape goes back
+// to where the cycle started. The MRU orders only change on commit, so the
+// previews don't reshuffle the list being cycled through.
+//
+// Window order comes from the client registry's MRU list and desktop order
+// from a small array here, so a cycle step never asks the server for anything.
+
+typedef enum {
+	CYCLE_NONE,
+	CYCLE_WINDOWS,
+	CYCLE_DESKTOPS,
+} CycleMode;
+
+static CycleMode mode = CYCLE_NONE;
+static unsigned int cycle_mask = 0;
+static size_t position = 0;
+
+static Window *windows = NULL;
+static size_t window_count = 0;
+static size_t window_capacity = 0;
+
+static unsigned long *desktop_order = NULL;
+static unsigned long *desktop_snapshot = NULL;
+
+void cycle_init(void) {
+	desktop_order = calloc(number_of_desktops, sizeof(unsigned long));
+	desktop_snapshot = calloc(number_of_desktops, sizeof(unsigned long));
+	if (!desktop_order || !desktop_snapshot) {
+		log_message(stderr, LOG_ERROR, "Failed to allocate desktop order");
+		exit(1);
+	}
+
+	desktop_order[0] = current_desktop;
+	for (unsigned long d = 1, i = 1; d <= number_of_desktops; d++) {
+		if (d != current_desktop) desktop_order[i++] = d;
+	}
+}
+
+bool cycle_active(void) {
+	return mode != CYCLE_NONE;
+}
+
+void cycle_desktop_visited(unsigned long desktop) {
+	if (mode != CYCLE_NONE || !desktop_order) return;
+
+	unsigned long i = 0;
+	while (i < number_of_desktops && desktop_order[i] != desktop) i++;
+	if (i == number_of_desktops) return;
+
+	for (; i > 0; i--) desktop_order[i] = desktop_order[i - 1];
+	desktop_order[0] = desktop;
+}
+
+static bool snapshot_windows(void) {
+	window_count = 0;
+	for (Client *c = client_mru_first(); c; c = c->mru_next) {
+		if (!c->alive || c->parked) continue;
+		if (!c->sticky && c->desktop != current_desktop) continue;
+
+		if (window_count == window_capacity) {
+			size_t capacity = window_capacity ? window_capacity * 2 : 32;
+			Window *grown = realloc(windows, capacity * sizeof(Window));
+			if (!grown) {
+				log_message(stderr, LOG_ERROR, "Failed to grow window cycle to %lu entries", (unsigned long)capacity);
+				break;
+			}
+			windows = grown;
+			window_capacity = capacity;
+		}
+		windows[window_count++] = c->window;
+	}
+	return window_count > 1;
+}
+
+// Focuses and raises a window without touching the MRU order.
+static void preview_window(Window window) {
+	if (!window_exists(window)) return;
+	XRaiseWindow(dpy, window);
+	XSetInputFocus(dpy, window, RevertToPointerRoot, CurrentTime);
+	update_borders(window);
+}
+
+static void preview(void) {
+	if (mode == CYCLE_WINDOWS) {
+		preview_window(windows[position]);
+	} else if (mode == CYCLE_DESKTOPS) {
+		switch_desktop(desktop_snapshot[position]);
+	}
+}
+
+static void finish(bool commit) {
+	CycleMode finished = mode;
+	mode = CYCLE_NONE;
+	XUngrabKeyboard(dpy, CurrentTime);
+
+	// Committing selects the previewed entry, cancelling the one the cycle
+	// started from. Either way the normal paths update the MRU order now.
+	size_t selected = commit ? position : 0;
+	if (finished == CYCLE_WINDOWS) {
+		activate_window(windows[selected]);
+	} else if (finished == CYCLE_DESKTOPS) {
+		unsigned long desktop = desktop_snapshot[selected];
+		if (desktop != current_desktop) {
+			switch_desktop(desktop);
+		} else {
+			cycle_desktop_visited(desktop);
+		}
+	}
+	log_message(stdout, LOG_DEBUG, "Cycle %s", commit ? "committed" : "cancelled");
+}
+
+static void step(CycleMode requested, int direction) {
+	bool starting = mode == CYCLE_NONE;
+
+	if (starting) {
+		if (requested == CYCLE_WINDOWS) {
+			if (!snapshot_windows()) return;
+		} else {
+			if (number_of_desktops < 2) return;
+			for (unsigned long i = 0; i < number_of_desktops; i++) desktop_snapshot[i] = desktop_order[i];
+		}
+		mode = requested;
+		position = 0;
+	} else if (mode != requested) {
+		return;
+	}
+
+	size_t count = mode == CYCLE_WINDOWS ? window_count : number_of_desktops;
+	position = (position + count + (direction < 0 ? -1 : 1)) % count;
+
+	if (starting) {
+		// Without a modifier to hold there is nothing to wait for, so the
+		// first step commits right away.
+		cycle_mask = keys_dispatch_state() & ~ShiftMask;
+		if (cycle_mask == 0 || XGrabKeyboard(dpy, DefaultRootWindow(dpy), True, GrabModeAsync, GrabModeAsync, CurrentTime) != GrabSuccess) {
+			finish(true);
+			return;
+		}
+	}
+
+	preview();
+}
+
+void cycle_windows(const Arg *arg) {
+	step(CYCLE_WINDOWS, arg->i);
+}
+
+void cycle_desktops(const Arg *arg) {
+	step(CYCLE_DESKTOPS, arg->i);
+}
+
+// Escape cancels a running cycle. Returns true when the key was consumed.
+bool cycle_key_press(const XKeyEvent *e) {
+	if (mode == CYCLE_NONE) return false;
+
+	if (XkbKeycodeToKeysym(dpy, e->keycode, 0, 0) == XK_Escape) {
+		finish(false);
+		return true;
+	}
+	return false;
+}
+
+// Releasing the modifier that started the cycle commits it.
+void cycle_key_release(const XKeyEvent *e) {
+	if (mode == CYCLE_NONE) return;
+
+	KeySym keysym = XkbKeycodeToKeysym(dpy, e->keycode, 0, 0);
+	if (XkbKeysymToModifiers(dpy, keysym) & cycle_mask) {
+		finish(true);
+	}
+}
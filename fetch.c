@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <X11/Xlib.h>
+
+#ifdef USE_XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#endif
+
+#include "plusminus.h"
+
+// Server queries that need replies. With USE_XCB the requests are issued as
+// cookies first and the replies collected afterwards, so a MapRequest pays
+// one round-trip in total instead of one per query.
+
+#ifdef USE_XCB
+
+bool fetch_map_info(Window root, Window window, MapInfo *info) {
+	xcb_connection_t *conn = XGetXCBConnection(dpy);
+
+	xcb_get_geometry_cookie_t geometry_cookie = xcb_get_geometry(conn, window);
+	xcb_query_pointer_cookie_t pointer_cookie = xcb_query_pointer(conn, root);
+
+	xcb_get_geometry_reply_t *geometry = xcb_get_geometry_reply(conn, geometry_cookie, NULL);
+	xcb_query_pointer_reply_t *pointer = xcb_query_pointer_reply(conn, pointer_cookie, NULL);
+
+	info->valid = geometry != NULL;
+	if (geometry) {
+		info->x = geometry->x;
+		info->y = geometry->y;
+		info->width = geometry->width;
+		info->height = geometry->height;
+		free(geometry);
+	}
+
+	info->pointer_valid = pointer != NULL && pointer->same_screen;
+	if (pointer) {
+		info->pointer_x = pointer->root_x;
+		info->pointer_y = pointer->root_y;
+		free(pointer);
+	}
+
+	return info->valid;
+}
+
+#else
+
+bool fetch_map_info(Window root, Window window, MapInfo *info) {
+	XWindowAttributes attr;
+	info->valid = XGetWindowAttributes(dpy, window, &attr) != 0;
+	if (info->valid) {
+		info->x = attr.x;
+		info->y = attr.y;
+		info->width = attr.width;
+		info->height = attr.height;
+	}
+
+	Window root_return, child_return;
+	int win_x, win_y;
+	unsigned int mask;
+	info->pointer_valid = XQueryPointer(dpy, root, &root_return, &child_return, &info->pointer_x, &info->pointer_y, &win_x, &win_y, &mask) != 0;
+
+	return info->valid;
+}
+
+#endif
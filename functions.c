@@ -8,37 +8,33 @@
 #include "plusminus.h"
 
 void move_window_x(const Arg *arg) {
-	if (active_window != None) {
-		XWindowAttributes attr;
-		XGetWindowAttributes(dpy, active_window, &attr);
-		XMoveWindow(dpy, active_window, attr.x + arg->i, attr.y);
+	Client *c = client_find(active_window);
+	if (c) {
+		client_move(c, c->x + arg->i, c->y);
 		log_message(stdout, LOG_DEBUG, "Move window 0x%lx on X by %d", active_window, arg->i);
 	}
 }
 
 void move_window_y(const Arg *arg) {
-	if (active_window != None) {
-		XWindowAttributes attr;
-		XGetWindowAttributes(dpy, active_window, &attr);
-		XMoveWindow(dpy, active_window, attr.x, attr.y + arg->i);
+	Client *c = client_find(active_window);
+	if (c) {
+		client_move(c, c->x, c->y + arg->i);
 		log_message(stdout, LOG_DEBUG, "Move window 0x%lx on Y by %d", active_window, arg->i);
 	}
 }
 
 void resize_window_x(const Arg *arg) {
-	if (active_window != None && window_exists(active_window)) {
-		XWindowAttributes attr;
-		XGetWindowAttributes(dpy, active_window, &attr);
-		XResizeWindow(dpy, active_window, MAX(1, attr.width + arg->i), attr.height);
+	Client *c = client_find(active_window);
+	if (c && c->alive) {
+		client_resize(c, MAX(1, c->width + arg->i), c->height);
 		log_message(stdout, LOG_DEBUG, "Resize window 0x%lx on X by %d", active_window, arg->i);
 	}
 }
 
 void resize_window_y(const Arg *arg) {
-	if (active_window != None && window_exists(active_window)) {
-		XWindowAttributes attr;
-		XGetWindowAttributes(dpy, active_window, &attr);
-		XResizeWindow(dpy, active_window, attr.width, MAX(1, attr.height + arg->i));
+	Client *c = client_find(active_window);
+	if (c && c->alive) {
+		client_resize(c, c->width, MAX(1, c->height + arg->i));
 		log_message(stdout, LOG_DEBUG, "Resize window 0x%lx on Y by %d", active_window, arg->i);
 	}
 }
@@ -66,19 +62,7 @@ void move_to_desktop(const Arg *arg) {
 		return;
 	}
 
-	set_window_desktop(active_window, target_desktop);
-	log_message(stdout, LOG_DEBUG, "Moved window 0x%lx from desktop %lu to desktop %lu", active_window, current_desktop, target_desktop);
-
-	XUnmapWindow(dpy, active_window);
-	log_message(stdout, LOG_DEBUG, "Unmapped window 0x%lx", active_window);
-
-	if (target_desktop != current_desktop) {
-		XSetWindowBorder(dpy, active_window, inactive_border);
-	} else {
-		XSetWindowBorder(dpy, active_window, active_border);
-	}
-
-	XFlush(dpy);
+	move_window_to_desktop(active_window, target_desktop);
 }
 
 void kill_window(const Arg *arg) {
@@ -89,8 +73,14 @@ void kill_window(const Arg *arg) {
 		return;
 	}
 
+	// Recorded window ids may belong to unrelated clients on the replay
+	// display.
+	if (journal_replaying()) {
+		log_message(stdout, LOG_DEBUG, "Not killing window 0x%lx during replay", active_window);
+		return;
+	}
+
 	XKillClient(dpy, active_window);
-	XFlush(dpy);
 	log_message(stdout, LOG_DEBUG, "Force killed window 0x%lx", active_window);
 }
 
@@ -102,21 +92,8 @@ void fullscreen(const Arg *arg) {
 		return;
 	}
 
-	XEvent event;
-	memset(&event, 0, sizeof(event));
-	event.type = ClientMessage;
-	event.xclient.window = active_window;
-	event.xclient.message_type = XInternAtom(dpy, "_NET_WM_STATE", False);
-	event.xclient.format = 32;
-	event.xclient.data.l[0] = 2; // _NET_WM_STATE_TOGGLE
-	event.xclient.data.l[1] = XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False);
-	event.xclient.data.l[2] = 0;
-	event.xclient.data.l[3] = 0;
-	event.xclient.data.l[4] = 0;
-
-	XSendEvent(dpy, DefaultRootWindow(dpy), False, SubstructureRedirectMask | SubstructureNotifyMask, &event);
-	XFlush(dpy);
-	log_message(stdout, LOG_DEBUG, "Sent fullscreen toggle request for window 0x%lx", active_window);
+	toggle_fullscreen(active_window);
+	log_message(stdout, LOG_DEBUG, "Toggled fullscreen for window 0x%lx", active_window);
 }
 
 void window_vmaximize(const Arg *arg) {
@@ -127,61 +104,37 @@ void window_vmaximize(const Arg *arg) {
 		return;
 	}
 
-	int index = find_vmaximize_window(active_window);
-	if (index >= 0) {
-		MaximizeState *state = &vmaximize_windows[index];
-		XWindowAttributes attr;
-		if (XGetWindowAttributes(dpy, active_window, &attr)) {
-			// Ensure the restored size is at least the minimum size
-			int restore_width = MAX(50, state->width);
-			int restore_height = MAX(50, state->height);
-			XMoveResizeWindow(dpy, active_window, state->x, state->y, restore_width, restore_height);
-		} else {
-			// Fallback if we can't get attributes
-			XMoveResizeWindow(dpy, active_window, state->x, state->y, state->width, state->height);
-		}
-		XFlush(dpy);
-		remove_vmaximize_window(active_window);
+	Client *c = client_find(active_window);
+
+	if (c->vmaximized) {
+		Geometry *state = &c->vmaximize_saved;
+		// Ensure the restored size is at least the minimum size
+		client_move_resize(c, state->x, state->y, MAX(50, state->width), MAX(50, state->height));
+		c->vmaximized = false;
 		log_message(stdout, LOG_DEBUG, "Restored window 0x%lx from vertical maximize to %dx%d at (%d,%d)", 
 			active_window, state->width, state->height, state->x, state->y);
 		return;
 	}
 
-	if (vmaximize_count >= MAX_MAXIMIZE_WINDOWS) {
-		log_message(stdout, LOG_DEBUG, "Maximum number of vertically maximized windows reached");
-		return;
-	}
-
-	XWindowAttributes attr;
-	if (!XGetWindowAttributes(dpy, active_window, &attr)) {
-		log_message(stdout, LOG_DEBUG, "Failed to get window attributes for 0x%lx", active_window);
-		return;
-	}
-
-	MaximizeState *state = &vmaximize_windows[vmaximize_count];
-	state->window = active_window;
-	state->x = attr.x;
-	state->y = attr.y;
-	state->width = attr.width;
-	state->height = attr.height;
-	vmaximize_count++;
+	Geometry *state = &c->vmaximize_saved;
+	*state = (Geometry){ c->x, c->y, c->width, c->height };
+	c->vmaximized = true;
 
 	log_message(stdout, LOG_DEBUG, "Saved window 0x%lx state: %dx%d at (%d,%d) for vertical maximize", 
 		active_window, state->width, state->height, state->x, state->y);
 
-	int screen_height = DisplayHeight(dpy, DefaultScreen(dpy));
-	int border_width = attr.border_width;
-	int new_x = attr.x;
-	int new_y = 0;
-	int new_width = attr.width;
-	int new_height = screen_height - (2 * border_width);
+	const Geometry *monitor = monitor_for_client(c);
+	int border_width = c->border_width;
+	int new_x = c->x;
+	int new_y = monitor->y;
+	int new_width = c->width;
+	int new_height = monitor->height - (2 * border_width);
 
 	if (new_height < 50) {
 		new_height = 50;
 	}
 
-	XMoveResizeWindow(dpy, active_window, new_x, new_y, new_width, new_height);
-	XFlush(dpy);
+	client_move_resize(c, new_x, new_y, new_width, new_height);
 
 	log_message(stdout, LOG_DEBUG, "Vertically maximized window 0x%lx to height %d", active_window, new_height);
 }
@@ -194,62 +147,37 @@ void window_hmaximize(const Arg *arg) {
 		return;
 	}
 
-	int index = find_hmaximize_window(active_window);
-	if (index >= 0) {
-		MaximizeState *state = &hmaximize_windows[index];
-		XWindowAttributes attr;
-		if (XGetWindowAttributes(dpy, active_window, &attr)) {
-			// Ensure the restored size is at least the minimum size
-			int restore_width = MAX(50, state->width);
-			int restore_height = MAX(50, state->height);
-			XMoveResizeWindow(dpy, active_window, state->x, state->y, restore_width, restore_height);
-		} else {
-			// Fallback if we can't get attributes
-			XMoveResizeWindow(dpy, active_window, state->x, state->y, state->width, state->height);
-		}
-		XFlush(dpy);
-		remove_hmaximize_window(active_window);
+	Client *c = client_find(active_window);
+
+	if (c->hmaximized) {
+		Geometry *state = &c->hmaximize_saved;
+		// Ensure the restored size is at least the minimum size
+		client_move_resize(c, state->x, state->y, MAX(50, state->width), MAX(50, state->height));
+		c->hmaximized = false;
 		log_message(stdout, LOG_DEBUG, "Restored window 0x%lx from horizontal maximize to %dx%d at (%d,%d)", 
 			active_window, state->width, state->height, state->x, state->y);
 		return;
 	}
 
-	// Check if we have space for another maximized window.
-	if (hmaximize_count >= MAX_MAXIMIZE_WINDOWS) {
-		log_message(stdout, LOG_DEBUG, "Maximum number of horizontally maximized windows reached");
-		return;
-	}
-
-	XWindowAttributes attr;
-	if (!XGetWindowAttributes(dpy, active_window, &attr)) {
-		log_message(stdout, LOG_DEBUG, "Failed to get window attributes for 0x%lx", active_window);
-		return;
-	}
-
-	MaximizeState *state = &hmaximize_windows[hmaximize_count];
-	state->window = active_window;
-	state->x = attr.x;
-	state->y = attr.y;
-	state->width = attr.width;
-	state->height = attr.height;
-	hmaximize_count++;
+	Geometry *state = &c->hmaximize_saved;
+	*state = (Geometry){ c->x, c->y, c->width, c->height };
+	c->hmaximized = true;
 
 	log_message(stdout, LOG_DEBUG, "Saved window 0x%lx state: %dx%d at (%d,%d) for horizontal maximize", 
 		active_window, state->width, state->height, state->x, state->y);
 
-	int screen_width = DisplayWidth(dpy, DefaultScreen(dpy));
-	int border_width = attr.border_width;
-	int new_x = 0;
-	int new_y = attr.y;
-	int new_width = screen_width - (2 * border_width);
-	int new_height = attr.height;
+	const Geometry *monitor = monitor_for_client(c);
+	int border_width = c->border_width;
+	int new_x = monitor->x;
+	int new_y = c->y;
+	int new_width = monitor->width - (2 * border_width);
+	int new_height = c->height;
 
 	if (new_width < 50) {
 		new_width = 50;
 	}
 
-	XMoveResizeWindow(dpy, active_window, new_x, new_y, new_width, new_height);
-	XFlush(dpy);
+	client_move_resize(c, new_x, new_y, new_width, new_height);
 
 	log_message(stdout, LOG_DEBUG, "Horizontally maximized window 0x%lx to width %d", active_window, new_width);
 }
@@ -262,16 +190,15 @@ void window_snap_up(const Arg *arg) {
 		return;
 	}
 
-	XWindowAttributes attr;
-	if (!XGetWindowAttributes(dpy, active_window, &attr)) {
-		log_message(stdout, LOG_DEBUG, "Failed to get window attributes for 0x%lx", active_window);
-		return;
-	}
+	Client *c = client_find(active_window);
+
+	// Stops at the nearest window edge above, or the top of the monitor.
+	int outer_width = c->width + 2 * c->border_width;
+	int new_y = spatial_edge_y(monitor_for_client(c), c->y, c->x, outer_width, false);
 
-	XMoveWindow(dpy, active_window, attr.x, 0);
-	XFlush(dpy);
+	client_move(c, c->x, new_y);
 
-	log_message(stdout, LOG_DEBUG, "Snapped window 0x%lx to top edge", active_window);
+	log_message(stdout, LOG_DEBUG, "Snapped window 0x%lx up to y=%d", active_window, new_y);
 }
 
 void window_snap_down(const Arg *arg) {
@@ -282,19 +209,16 @@ void window_snap_down(const Arg *arg) {
 		return;
 	}
 
-	XWindowAttributes attr;
-	if (!XGetWindowAttributes(dpy, active_window, &attr)) {
-		log_message(stdout, LOG_DEBUG, "Failed to get window attributes for 0x%lx", active_window);
-		return;
-	}
+	Client *c = client_find(active_window);
 
-	int screen_height = DisplayHeight(dpy, DefaultScreen(dpy));
-	int new_y = screen_height - attr.height - (2 * attr.border_width);
+	// Stops at the nearest window edge below, or the bottom of the monitor.
+	int outer_width = c->width + 2 * c->border_width;
+	int outer_height = c->height + 2 * c->border_width;
+	int new_y = spatial_edge_y(monitor_for_client(c), c->y + outer_height, c->x, outer_width, true) - outer_height;
 
-	XMoveWindow(dpy, active_window, attr.x, new_y);
-	XFlush(dpy);
+	client_move(c, c->x, new_y);
 
-	log_message(stdout, LOG_DEBUG, "Snapped window 0x%lx to bottom edge at y=%d", active_window, new_y);
+	log_message(stdout, LOG_DEBUG, "Snapped window 0x%lx down to y=%d", active_window, new_y);
 }
 
 void window_snap_right(const Arg *arg) {
@@ -305,19 +229,16 @@ void window_snap_right(const Arg *arg) {
 		return;
 	}
 
-	XWindowAttributes attr;
-	if (!XGetWindowAttributes(dpy, active_window, &attr)) {
-		log_message(stdout, LOG_DEBUG, "Failed to get window attributes for 0x%lx", active_window);
-		return;
-	}
+	Client *c = client_find(active_window);
 
-	int screen_width = DisplayWidth(dpy, DefaultScreen(dpy));
-	int new_x = screen_width - attr.width - (2 * attr.border_width);
+	// Stops at the nearest window edge to the right, or the monitor edge.
+	int outer_width = c->width + 2 * c->border_width;
+	int outer_height = c->height + 2 * c->border_width;
+	int new_x = spatial_edge_x(monitor_for_client(c), c->x + outer_width, c->y, outer_height, true) - outer_width;
 
-	XMoveWindow(dpy, active_window, new_x, attr.y);
-	XFlush(dpy);
+	client_move(c, new_x, c->y);
 
-	log_message(stdout, LOG_DEBUG, "Snapped window 0x%lx to right edge at x=%d", active_window, new_x);
+	log_message(stdout, LOG_DEBUG, "Snapped window 0x%lx right to x=%d", active_window, new_x);
 }
 
 void window_snap_left(const Arg *arg) {
@@ -328,16 +249,15 @@ void window_snap_left(const Arg *arg) {
 		return;
 	}
 
-	XWindowAttributes attr;
-	if (!XGetWindowAttributes(dpy, active_window, &attr)) {
-		log_message(stdout, LOG_DEBUG, "Failed to get window attributes for 0x%lx", active_window);
-		return;
-	}
+	Client *c = client_find(active_window);
 
-	XMoveWindow(dpy, active_window, 0, attr.y);
-	XFlush(dpy);
+	// Stops at the nearest window edge to the left, or the monitor edge.
+	int outer_height = c->height + 2 * c->border_width;
+	int new_x = spatial_edge_x(monitor_for_client(c), c->x, c->y, outer_height, false);
 
-	log_message(stdout, LOG_DEBUG, "Snapped window 0x%lx to left edge", active_window);
+	client_move(c, new_x, c->y);
+
+	log_message(stdout, LOG_DEBUG, "Snapped window 0x%lx left to x=%d", active_window, new_x);
 }
 
 void sticky(const Arg *arg) {
@@ -361,6 +281,24 @@ void sticky(const Arg *arg) {
 		XSetWindowBorder(dpy, active_window, sticky_active_border);
 		log_message(stdout, LOG_DEBUG, "Made window 0x%lx sticky (desktop 0)", active_window);
 	}
+}
+
+void set_layout(const Arg *arg) {
+	layout_set(current_desktop, (Layout)arg->i);
+}
+
+void focus_direction(const Arg *arg) {
+	Client *c = client_find(active_window);
+	if (!c || !c->alive) {
+		log_message(stdout, LOG_DEBUG, "No active window to move focus from");
+		return;
+	}
+
+	Client *neighbour = spatial_neighbour(c, (Direction)arg->i);
+	if (!neighbour) {
+		log_message(stdout, LOG_DEBUG, "No window in direction %d of 0x%lx", arg->i, active_window);
+		return;
+	}
 
-	XFlush(dpy);
+	activate_window(neighbour->window);
 }
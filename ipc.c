@@ -0,0 +1,354 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "plusminus.h"
+
+// Control socket. Scripts connect to a Unix socket and send newline separated
+// commands; every command gets its output lines followed by "ok" or a single
+// "error <reason>" line. All commands that arrive in one loop iteration are
+// applied back to back and the X requests they produce go out with the single
+// flush the event loop does before blocking, so a batch costs one write to the
+// server no matter how many commands it holds.
+//
+// A connection that sends "subscribe" stops taking commands and instead gets
+// a line for every focus and desktop change.
+
+#define IPC_MAX_CLIENTS (IPC_MAX_FDS - 1)
+#define IPC_BUFFER_SIZE 4096
+
+typedef struct {
+	int fd;
+	bool subscribed;
+	bool closed;
+	size_t length;
+	char buffer[IPC_BUFFER_SIZE];
+} IpcClient;
+
+typedef struct {
+	const char *name;
+	void (*func)(const Arg *arg);
+	bool takes_argument;
+} IpcCommand;
+
+static const IpcCommand commands[] = {
+	{ "move_window_x",     move_window_x,     true  },
+	{ "move_window_y",     move_window_y,     true  },
+	{ "resize_window_x",   resize_window_x,   true  },
+	{ "resize_window_y",   resize_window_y,   true  },
+	{ "switch_to_desktop", switch_to_desktop, true  },
+	{ "move_to_desktop",   move_to_desktop,   true  },
+	{ "kill_window",       kill_window,       false },
+	{ "fullscreen",        fullscreen,        false },
+	{ "window_vmaximize",  window_vmaximize,  false },
+	{ "window_hmaximize",  window_hmaximize,  false },
+	{ "window_snap_up",    window_snap_up,    false },
+	{ "window_snap_down",  window_snap_down,  false },
+	{ "window_snap_right", window_snap_right, false },
+	{ "window_snap_left",  window_snap_left,  false },
+	{ "sticky",            sticky,            false },
+	{ "set_layout",        set_layout,        true  },
+	{ "focus_direction",   focus_direction,   true  },
+};
+
+static int listen_fd = -1;
+static char socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static IpcClient clients[IPC_MAX_CLIENTS];
+static int client_count = 0;
+
+// Closed clients are only marked while commands run, since a command can
+// notify subscribers in the middle of walking the client table. They are
+// removed before the next poll.
+static void remove_closed_clients(void) {
+	for (int i = client_count - 1; i >= 0; i--) {
+		if (!clients[i].closed) continue;
+		close(clients[i].fd);
+		clients[i] = clients[--client_count];
+	}
+}
+
+static bool write_line(IpcClient *client, const char *line, int length) {
+	if (client->closed) return false;
+	if (send(client->fd, line, length, MSG_NOSIGNAL) != length) {
+		client->closed = true;
+		return false;
+	}
+	return true;
+}
+
+// Replies are small, so they are written straight to the socket. A peer that
+// doesn't keep up is dropped rather than allowed to stall the WM.
+static bool send_line(IpcClient *client, const char *format, ...) {
+	char line[256];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(line, sizeof(line) - 1, format, args);
+	va_end(args);
+
+	if (length < 0) return false;
+	if ((size_t)length > sizeof(line) - 2) length = sizeof(line) - 2;
+	line[length++] = '\n';
+
+	return write_line(client, line, length);
+}
+
+static bool parse_window(const char *text, Window *window) {
+	char *end;
+	errno = 0;
+	unsigned long value = strtoul(text, &end, 0);
+	if (errno != 0 || end == text || *end != '\0') return false;
+	*window = (Window)value;
+	return true;
+}
+
+static bool query_clients(IpcClient *client) {
+	for (Client *c = client_first(); c; c = c->next) {
+		if (!c->alive) continue;
+		if (!send_line(client, "0x%lx %lu %d %d %d %d%s%s%s",
+					c->window, c->sticky ? 0 : c->desktop,
+					c->x, c->y, c->width, c->height,
+					c->window == active_window ? " active" : "",
+					c->mapped && !c->parked ? " visible" : "",
+					c->fullscreen ? " fullscreen" : "")) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Runs one command line. Returns false when the client has to be dropped.
+static bool run_command(IpcClient *client, char *line) {
+	char *name = strtok(line, " \t");
+	char *argument = strtok(NULL, " \t");
+	if (!name) return true;
+
+	if (strcmp(name, "subscribe") == 0) {
+		client->subscribed = true;
+		return send_line(client, "ok");
+	}
+
+	if (strcmp(name, "clients") == 0) {
+		return query_clients(client) && send_line(client, "ok");
+	}
+
+	if (strcmp(name, "active") == 0) {
+		return send_line(client, "0x%lx", active_window) && send_line(client, "ok");
+	}
+
+	if (strcmp(name, "current_desktop") == 0) {
+		return send_line(client, "%lu", current_desktop) && send_line(client, "ok");
+	}
+
+	if (strcmp(name, "focus") == 0) {
+		Window window;
+		if (!argument || !parse_window(argument, &window)) return send_line(client, "error focus needs a window id");
+		if (!window_exists(window)) return send_line(client, "error no such window");
+		activate_window(window);
+		return send_line(client, "ok");
+	}
+
+	for (size_t i = 0; i < LENGTH(commands); i++) {
+		if (strcmp(name, commands[i].name) != 0) continue;
+
+		Arg arg = { 0 };
+		if (commands[i].takes_argument) {
+			char *end;
+			if (!argument) return send_line(client, "error %s needs an argument", name);
+			arg.i = (int)strtol(argument, &end, 10);
+			if (*end != '\0') return send_line(client, "error invalid argument %s", argument);
+		}
+
+		commands[i].func(&arg);
+		return send_line(client, "ok");
+	}
+
+	return send_line(client, "error unknown command %s", name);
+}
+
+// Reads what the client has sent and runs every complete line.
+static bool read_commands(IpcClient *client) {
+	ssize_t received = read(client->fd, client->buffer + client->length, IPC_BUFFER_SIZE - client->length);
+	if (received == 0) return false;
+	if (received < 0) return errno == EAGAIN || errno == EINTR;
+
+	// Subscribers only listen, anything they send is ignored.
+	if (client->subscribed) return true;
+	client->length += received;
+
+	char *line = client->buffer;
+	char *newline;
+	while (!client->subscribed && !client->closed && (newline = memchr(line, '\n', client->buffer + client->length - line))) {
+		*newline = '\0';
+		if (newline > line && newline[-1] == '\r') newline[-1] = '\0';
+		if (!run_command(client, line)) return false;
+		line = newline + 1;
+	}
+
+	client->length -= line - client->buffer;
+	memmove(client->buffer, line, client->length);
+
+	if (client->length == IPC_BUFFER_SIZE) {
+		send_line(client, "error line too long");
+		return false;
+	}
+	return true;
+}
+
+static void set_nonblocking(int fd) {
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+static void accept_clients(void) {
+	int fd;
+	while ((fd = accept(listen_fd, NULL, NULL)) != -1) {
+		if (client_count == IPC_MAX_CLIENTS) {
+			log_message(stderr, LOG_WARNING, "Too many control connections, refusing one");
+			close(fd);
+			continue;
+		}
+
+		set_nonblocking(fd);
+		clients[client_count++] = (IpcClient){ .fd = fd };
+	}
+}
+
+// Without $XDG_RUNTIME_DIR the socket goes into a directory of our own under
+// /tmp. Another user could have created that path first, so it is only used
+// when it is a real directory owned by us that nobody else can enter.
+static bool private_directory(const char *directory) {
+	if (mkdir(directory, 0700) == -1 && errno != EEXIST) {
+		log_message(stderr, LOG_ERROR, "Failed to create %s: %s", directory, strerror(errno));
+		return false;
+	}
+
+	struct stat st;
+	if (lstat(directory, &st) == -1 || !S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 077) != 0) {
+		log_message(stderr, LOG_ERROR, "Refusing to use %s, it is not a private directory", directory);
+		return false;
+	}
+	return true;
+}
+
+// The socket lives in $XDG_RUNTIME_DIR (or /tmp/plusminus-<uid>) and is named
+// after the display, so WMs on different displays don't collide.
+// PLUSMINUS_SOCKET overrides the path.
+static bool build_socket_path(void) {
+	const char *path = getenv("PLUSMINUS_SOCKET");
+	if (path && *path) {
+		snprintf(socket_path, sizeof(socket_path), "%s", path);
+		return true;
+	}
+
+	char fallback[64];
+	const char *directory = getenv("XDG_RUNTIME_DIR");
+	if (!directory || !*directory) {
+		snprintf(fallback, sizeof(fallback), "/tmp/plusminus-%lu", (unsigned long)getuid());
+		if (!private_directory(fallback)) return false;
+		directory = fallback;
+	}
+
+	const char *display = DisplayString(dpy);
+	const char *colon = strrchr(display, ':');
+	snprintf(socket_path, sizeof(socket_path), "%s/plusminus%s.sock", directory, colon ? colon : ":0");
+	return true;
+}
+
+// Only a socket of our own is removed before binding; anything else at the
+// path is left alone and the bind fails.
+static void remove_stale_socket(void) {
+	struct stat st;
+	if (lstat(socket_path, &st) == -1) return;
+	if (S_ISSOCK(st.st_mode) && st.st_uid == getuid()) {
+		unlink(socket_path);
+	} else {
+		log_message(stderr, LOG_WARNING, "%s exists and is not our socket, leaving it alone", socket_path);
+	}
+}
+
+void ipc_init(void) {
+	if (!build_socket_path()) return;
+
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_fd == -1) {
+		log_message(stderr, LOG_ERROR, "Failed to create control socket: %s", strerror(errno));
+		return;
+	}
+	set_nonblocking(listen_fd);
+
+	struct sockaddr_un address = { .sun_family = AF_UNIX };
+	memcpy(address.sun_path, socket_path, sizeof(address.sun_path));
+
+	// A socket left behind by a WM that didn't exit cleanly.
+	remove_stale_socket();
+
+	if (bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) == -1 || listen(listen_fd, 8) == -1) {
+		log_message(stderr, LOG_ERROR, "Failed to listen on %s: %s", socket_path, strerror(errno));
+		close(listen_fd);
+		listen_fd = -1;
+		return;
+	}
+
+	setenv("PLUSMINUS_SOCKET", socket_path, 1);
+	log_message(stdout, LOG_INFO, "Listening for commands on %s", socket_path);
+}
+
+int ipc_poll_fds(struct pollfd *fds) {
+	remove_closed_clients();
+	if (listen_fd == -1) return 0;
+
+	fds[0] = (struct pollfd){ .fd = listen_fd, .events = POLLIN };
+	for (int i = 0; i < client_count; i++) {
+		fds[i + 1] = (struct pollfd){ .fd = clients[i].fd, .events = POLLIN };
+	}
+	return client_count + 1;
+}
+
+void ipc_handle(const struct pollfd *fds, int count) {
+	if (count == 0) return;
+
+	// fds[i + 1] belongs to clients[i], the table doesn't change until the
+	// next ipc_poll_fds call.
+	for (int i = 0; i < count - 1; i++) {
+		if (clients[i].closed || !(fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+		if (!read_commands(&clients[i])) clients[i].closed = true;
+	}
+
+	if (fds[0].revents & POLLIN) accept_clients();
+}
+
+void ipc_notify(const char *format, ...) {
+	char line[256];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(line, sizeof(line) - 1, format, args);
+	va_end(args);
+
+	if (length < 0) return;
+	if ((size_t)length > sizeof(line) - 2) length = sizeof(line) - 2;
+	line[length++] = '\n';
+
+	for (int i = 0; i < client_count; i++) {
+		if (clients[i].subscribed) write_line(&clients[i], line, length);
+	}
+}
+
+void ipc_cleanup(void) {
+	for (int i = 0; i < client_count; i++) clients[i].closed = true;
+	remove_closed_clients();
+	if (listen_fd == -1) return;
+
+	close(listen_fd);
+	unlink(socket_path);
+	listen_fd = -1;
+}
@@ -0,0 +1,236 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "plusminus.h"
+
+// Event journal. When PLUSMINUS_JOURNAL names a file every event read from the
+// server is appended to it together with the time it arrived, and
+// `plusminus --replay <file>` feeds a journal back through the event handler
+// to compare handler cost between builds.
+//
+// The file starts with a small header and then holds one record per event:
+// a 64-bit arrival time in nanoseconds since recording started, the 16-bit
+// size of the event that follows and only that many bytes of the XEvent, so
+// small events don't pay for the whole union.
+//
+// Every event the WM takes off the queue goes through event_next(), including
+// the ones the motion and key repeat coalescing drain, so the journal holds
+// the complete stream. During a replay the same functions hand out journal
+// events instead, so the drains coalesce exactly what was recorded.
+
+#define JOURNAL_MAGIC "PMJ1"
+
+typedef struct {
+	char magic[4];
+	uint32_t event_size;
+} JournalHeader;
+
+typedef struct {
+	int64_t time;
+	uint16_t size;
+} JournalRecord;
+
+static FILE *journal = NULL;
+static long long journal_start = 0;
+
+// Events put back on the live queue were recorded when they were taken.
+static int put_back = 0;
+
+static bool replaying = false;
+static XEvent *replay_events = NULL;
+static size_t replay_count = 0;
+static size_t replay_position = 0;
+
+// Size of the part of the XEvent union used by the given event type.
+static uint16_t event_size(int type) {
+	switch (type) {
+		case KeyPress:
+		case KeyRelease: return sizeof(XKeyEvent);
+		case ButtonPress:
+		case ButtonRelease: return sizeof(XButtonEvent);
+		case MotionNotify: return sizeof(XMotionEvent);
+		case EnterNotify:
+		case LeaveNotify: return sizeof(XCrossingEvent);
+		case FocusIn:
+		case FocusOut: return sizeof(XFocusChangeEvent);
+		case Expose: return sizeof(XExposeEvent);
+		case DestroyNotify: return sizeof(XDestroyWindowEvent);
+		case UnmapNotify: return sizeof(XUnmapEvent);
+		case MapNotify: return sizeof(XMapEvent);
+		case MapRequest: return sizeof(XMapRequestEvent);
+		case ConfigureNotify: return sizeof(XConfigureEvent);
+		case ConfigureRequest: return sizeof(XConfigureRequestEvent);
+		case PropertyNotify: return sizeof(XPropertyEvent);
+		case ClientMessage: return sizeof(XClientMessageEvent);
+		case MappingNotify: return sizeof(XMappingEvent);
+		default: return sizeof(XEvent);
+	}
+}
+
+void journal_open(void) {
+	const char *path = getenv("PLUSMINUS_JOURNAL");
+	if (!path || !*path) return;
+
+	journal = fopen(path, "wb");
+	if (!journal) {
+		log_message(stderr, LOG_ERROR, "Failed to open event journal %s", path);
+		return;
+	}
+
+	JournalHeader header = { .event_size = sizeof(XEvent) };
+	memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+	fwrite(&header, sizeof(header), 1, journal);
+
+	journal_start = monotonic_ns();
+	log_message(stdout, LOG_INFO, "Recording events to %s", path);
+}
+
+static void journal_record(const XEvent *e) {
+	if (!journal) return;
+
+	// Generic events carry their payload out of line and can't be replayed.
+	if (e->type == GenericEvent) return;
+
+	JournalRecord record = {
+		.time = monotonic_ns() - journal_start,
+		.size = event_size(e->type),
+	};
+	fwrite(&record, sizeof(record), 1, journal);
+	fwrite(e, record.size, 1, journal);
+}
+
+// True while a journal is being replayed. Actions that reach outside the
+// WM, spawning shortcuts and killing clients, are skipped then.
+bool journal_replaying(void) {
+	return replaying;
+}
+
+// Number of events that can be taken without blocking.
+int event_queued(void) {
+	if (replaying) return (int)(replay_count - replay_position);
+	return XEventsQueued(dpy, QueuedAfterReading);
+}
+
+// Copies the next event without taking it. Only valid when event_queued()
+// is non-zero.
+void event_peek(XEvent *e) {
+	if (replaying) {
+		*e = replay_events[replay_position];
+		return;
+	}
+	XPeekEvent(dpy, e);
+}
+
+void event_next(XEvent *e) {
+	if (replaying) {
+		*e = replay_events[replay_position++];
+		return;
+	}
+
+	XNextEvent(dpy, e);
+	if (put_back > 0) {
+		put_back--;
+	} else {
+		journal_record(e);
+	}
+}
+
+// Returns the event taken last to the head of the queue.
+void event_put_back(XEvent *e) {
+	if (replaying) {
+		replay_position--;
+		return;
+	}
+	XPutBackEvent(dpy, e);
+	put_back++;
+}
+
+// Writes buffered records out. Called when the event loop goes idle.
+void journal_flush(void) {
+	if (journal) fflush(journal);
+}
+
+void journal_close(void) {
+	if (!journal) return;
+	fclose(journal);
+	journal = NULL;
+}
+
+int journal_replay(const char *path, void (*dispatch)(const XEvent *e)) {
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		log_message(stderr, LOG_ERROR, "Failed to open event journal %s", path);
+		return 1;
+	}
+
+	JournalHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0) {
+		log_message(stderr, LOG_ERROR, "%s is not an event journal", path);
+		fclose(file);
+		return 1;
+	}
+	if (header.event_size != sizeof(XEvent)) {
+		log_message(stderr, LOG_ERROR, "%s was recorded with a different XEvent size (%u)", path, header.event_size);
+		fclose(file);
+		return 1;
+	}
+
+	// The whole journal is loaded first so the replay measures the handlers
+	// and not the file reads.
+	long long recorded = 0;
+	size_t capacity = 0;
+	JournalRecord record;
+	while (fread(&record, sizeof(record), 1, file) == 1) {
+		if (replay_count == capacity) {
+			capacity = capacity ? capacity * 2 : 1024;
+			XEvent *grown = realloc(replay_events, capacity * sizeof(XEvent));
+			if (!grown) {
+				log_message(stderr, LOG_ERROR, "Failed to load event journal %s", path);
+				break;
+			}
+			replay_events = grown;
+		}
+
+		XEvent *e = &replay_events[replay_count];
+		memset(e, 0, sizeof(*e));
+		if (record.size > sizeof(XEvent) || fread(e, record.size, 1, file) != 1) {
+			log_message(stderr, LOG_WARNING, "Event journal %s is truncated", path);
+			break;
+		}
+
+		// The display pointer is from the recording process.
+		e->xany.display = dpy;
+		replay_count++;
+		recorded = record.time;
+	}
+	fclose(file);
+
+	replaying = true;
+	long long started = monotonic_ns();
+	while (replay_position < replay_count) {
+		XEvent e;
+		event_next(&e);
+		dispatch(&e);
+
+		// What the server sends back in response is already in the journal
+		// as far as it mattered, so live events are dropped unhandled.
+		while (XPending(dpy)) {
+			XEvent live;
+			XNextEvent(dpy, &live);
+		}
+	}
+	replaying = false;
+
+	long long elapsed = monotonic_ns() - started;
+	log_message(stdout, LOG_INFO, "Replayed %lu events in %.1fms (recorded over %.1fs)", (unsigned long)replay_count, elapsed / 1000000.0, recorded / 1000000000.0);
+	stats_dump();
+
+	free(replay_events);
+	replay_events = NULL;
+	replay_count = replay_position = 0;
+	return 0;
+}
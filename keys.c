@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <X11/XKBlib.h>
+
+#include "plusminus.h"
+
+// Key dispatch. Bindings are resolved once into a table indexed by keycode
+// and by the modifier state with Lock and NumLock stripped, so a KeyPress is
+// a single lookup no matter how many bindings are configured. The table and
+// the grabs are rebuilt whenever the keyboard mapping changes.
+//
+// Auto-repeated presses of move and resize bindings that are already queued
+// are folded into one call with the summed delta, so a held key costs one
+// configure per batch of events instead of one per repeat.
+
+#define MOD_STATES 128  // Shift, Control and Mod1-Mod5.
+
+typedef struct {
+	const Keybinds *keybind;
+	const Shortcut *shortcut;
+} KeyAction;
+
+static KeyAction *key_table[256];
+
+static Window root;
+static const Keybinds *keybinds;
+static size_t keybinds_count;
+static const Shortcut *shortcuts;
+static size_t shortcuts_count;
+
+static unsigned int numlock_mask = 0;
+static unsigned int drag_mod = 0;
+
+// Modifiers of the key event being dispatched, without the lock bits.
+static unsigned int dispatch_state = 0;
+
+static bool accelerate = false;
+static KeyCode repeat_keycode = 0;
+static int repeat_run = 0;
+
+// Packs the seven relevant modifier bits into 0..127; Lock is bit 1 and is
+// dropped.
+static unsigned int mod_index(unsigned int state) {
+	state &= ~(LockMask | numlock_mask);
+	return (state & ShiftMask) | ((state & (ControlMask | Mod1Mask | Mod2Mask | Mod3Mask | Mod4Mask | Mod5Mask)) >> 1);
+}
+
+static void update_numlock_mask(void) {
+	numlock_mask = 0;
+
+	KeyCode numlock = XKeysymToKeycode(dpy, XK_Num_Lock);
+	XModifierKeymap *modmap = XGetModifierMapping(dpy);
+	for (int i = 0; i < 8; i++) {
+		for (int j = 0; j < modmap->max_keypermod; j++) {
+			if (numlock && modmap->modifiermap[i * modmap->max_keypermod + j] == numlock) {
+				numlock_mask = 1u << i;
+			}
+		}
+	}
+	XFreeModifiermap(modmap);
+}
+
+static KeyAction *table_entry(KeyCode keycode, unsigned int mod) {
+	if (!key_table[keycode]) {
+		key_table[keycode] = calloc(MOD_STATES, sizeof(KeyAction));
+		if (!key_table[keycode]) {
+			log_message(stderr, LOG_ERROR, "Failed to allocate key table for keycode %u", keycode);
+			return NULL;
+		}
+	}
+	return &key_table[keycode][mod_index(mod)];
+}
+
+static void grab_with_locks(KeyCode keycode, unsigned int mod) {
+	unsigned int locks[] = { 0, LockMask, numlock_mask, numlock_mask | LockMask };
+	for (unsigned int i = 0; i < LENGTH(locks); i++) {
+		XGrabKey(dpy, keycode, mod | locks[i], root, True, GrabModeAsync, GrabModeAsync);
+	}
+}
+
+void keys_init(Window root_window, const Keybinds *kb, size_t kb_count, const Shortcut *sc, size_t sc_count, bool repeat_acceleration, unsigned int drag_modifier) {
+	root = root_window;
+	accelerate = repeat_acceleration;
+	drag_mod = drag_modifier;
+
+	// Repeats then arrive as plain KeyPress events without a KeyRelease in
+	// between, which makes them easy to coalesce.
+	XkbSetDetectableAutoRepeat(dpy, True, NULL);
+
+	keybinds = kb;
+	keybinds_count = kb_count;
+	shortcuts = sc;
+	shortcuts_count = sc_count;
+	keys_grab();
+}
+
+void keys_grab(void) {
+	update_numlock_mask();
+
+	for (unsigned int i = 0; i < LENGTH(key_table); i++) {
+		free(key_table[i]);
+		key_table[i] = NULL;
+	}
+	XUngrabKey(dpy, AnyKey, AnyModifier, root);
+
+	// Buttons 1 and 3 with the drag modifier move and resize windows. Like
+	// the keys they are grabbed for every Lock/NumLock combination, which
+	// has to follow the modifier map.
+	XUngrabButton(dpy, AnyButton, AnyModifier, root);
+	unsigned int locks[] = { 0, LockMask, numlock_mask, numlock_mask | LockMask };
+	for (unsigned int i = 0; i < LENGTH(locks); i++) {
+		XGrabButton(dpy, 1, drag_mod | locks[i], root, True, ButtonPressMask | ButtonReleaseMask | PointerMotionMask, GrabModeAsync, GrabModeAsync, None, None);
+		XGrabButton(dpy, 3, drag_mod | locks[i], root, True, ButtonPressMask | ButtonReleaseMask | PointerMotionMask, GrabModeAsync, GrabModeAsync, None, None);
+	}
+
+	// Shortcuts go in first so a keybind on the same key wins.
+	for (size_t i = 0; i < shortcuts_count; i++) {
+		KeyCode keycode = XKeysymToKeycode(dpy, shortcuts[i].keysym);
+		if (!keycode) continue;
+
+		KeyAction *action = table_entry(keycode, shortcuts[i].mod);
+		if (!action) continue;
+		action->shortcut = &shortcuts[i];
+		grab_with_locks(keycode, shortcuts[i].mod);
+		log_message(stdout, LOG_DEBUG, "Grabbed shortcut: mod=0x%x, keysym=0x%lx, command=%s", shortcuts[i].mod, shortcuts[i].keysym, shortcuts[i].cmd);
+	}
+
+	for (size_t i = 0; i < keybinds_count; i++) {
+		KeyCode keycode = XKeysymToKeycode(dpy, keybinds[i].keysym);
+		if (!keycode) continue;
+
+		KeyAction *action = table_entry(keycode, keybinds[i].mod);
+		if (!action) continue;
+		action->keybind = &keybinds[i];
+		action->shortcut = NULL;
+		grab_with_locks(keycode, keybinds[i].mod);
+		log_message(stdout, LOG_DEBUG, "Grabbed key: mod=0x%x, keysym=0x%lx", keybinds[i].mod, keybinds[i].keysym);
+	}
+}
+
+static bool is_coalescable(const Keybinds *keybind) {
+	return keybind->func == move_window_x || keybind->func == move_window_y ||
+		keybind->func == resize_window_x || keybind->func == resize_window_y;
+}
+
+// Removes queued presses of the same key from the head of the event queue and
+// returns how many there were. Servers without detectable auto-repeat send a
+// KeyRelease/KeyPress pair per repeat, those pairs are consumed as well.
+static int drain_repeats(const XKeyEvent *e) {
+	int count = 0;
+
+	while (event_queued() > 0) {
+		XEvent next;
+		event_peek(&next);
+
+		if (next.type == KeyPress && next.xkey.keycode == e->keycode && next.xkey.state == e->state) {
+			event_next(&next);
+			count++;
+			continue;
+		}
+
+		if (next.type == KeyRelease && next.xkey.keycode == e->keycode && event_queued() > 1) {
+			XEvent release;
+			event_next(&release);
+			event_peek(&next);
+			if (next.type == KeyPress && next.xkey.keycode == e->keycode && next.xkey.time == release.xkey.time) {
+				event_next(&next);
+				count++;
+				continue;
+			}
+			event_put_back(&release);
+		}
+		break;
+	}
+
+	return count;
+}
+
+// Step multiplier for the n-th press of a held key: ramps from 1x up to 4x.
+static int acceleration(int run) {
+	if (!accelerate) return 1;
+	int factor = run / 8 + 1;
+	return factor > 4 ? 4 : factor;
+}
+
+void keys_release(const XKeyEvent *e) {
+	if (e->keycode == repeat_keycode) {
+		repeat_keycode = 0;
+		repeat_run = 0;
+	}
+}
+
+unsigned int keys_dispatch_state(void) {
+	return dispatch_state;
+}
+
+void keys_dispatch(const XKeyEvent *e) {
+	if (!key_table[e->keycode]) return;
+
+	dispatch_state = e->state & ~(LockMask | numlock_mask);
+
+	KeyAction *action = &key_table[e->keycode][mod_index(e->state)];
+	if (action->keybind && is_coalescable(action->keybind)) {
+		if (e->keycode != repeat_keycode) {
+			repeat_keycode = e->keycode;
+			repeat_run = 0;
+		}
+
+		int presses = 1 + drain_repeats(e);
+		Arg arg = action->keybind->arg;
+		arg.i = 0;
+		for (int i = 0; i < presses; i++) {
+			arg.i += action->keybind->arg.i * acceleration(repeat_run++);
+		}
+
+		if (presses > 1) {
+			log_message(stdout, LOG_DEBUG, "Coalesced %d key presses into one step of %d", presses, arg.i);
+		}
+		action->keybind->func(&arg);
+	} else if (action->keybind) {
+		action->keybind->func(&action->keybind->arg);
+	} else if (action->shortcut) {
+		execute_shortcut(action->shortcut->cmd);
+	}
+}
@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <X11/Xlib.h>
+
+#include "plusminus.h"
+
+// Tiling layouts. Every desktop has its own layout, floating by default. When
+// a desktop's set of windows changes, layout_arrange() computes the rectangle
+// of every tiled client and configures only those whose cached geometry
+// differs. All configures of one arrange go out in the event loop's next
+// flush.
+//
+// Tiled clients are the live, non-fullscreen members of a desktop. Each
+// desktop keeps them in a tile order: new windows take the next slot and a
+// window that goes away hands its slot to the last tile, so the other tiles
+// keep their place. The first slot is the master. Sticky clients always float.
+// A desktop tiles on the monitor holding its master, so windows moved to
+// another output take the layout with them.
+//
+// Slots only stay put while the layout's shape does. Master/stack resizes
+// every stack row when the stack grows or shrinks, and a grid reflows every
+// tile when the count crosses a row or column boundary (30 to 31 tiles adds a
+// sixth row). Otherwise a grid touches the last row and the moved tile.
+
+typedef struct {
+	Window *windows;
+	int count;
+	int capacity;
+} TileOrder;
+
+static Layout *layouts = NULL;
+static TileOrder *orders = NULL;
+static int master_percent = 55;
+
+void layout_init(Layout default_layout, int master_size) {
+	layouts = calloc(number_of_desktops + 1, sizeof(Layout));
+	orders = calloc(number_of_desktops + 1, sizeof(TileOrder));
+	if (!layouts || !orders) {
+		log_message(stderr, LOG_ERROR, "Failed to allocate desktop layouts");
+		exit(1);
+	}
+
+	for (unsigned long i = 0; i <= number_of_desktops; i++) {
+		layouts[i] = default_layout;
+	}
+	layouts[0] = LAYOUT_FLOATING;
+
+	if (master_size >= 10 && master_size <= 90) {
+		master_percent = master_size;
+	}
+}
+
+Layout layout_get(unsigned long desktop) {
+	if (desktop < 1 || desktop > number_of_desktops) return LAYOUT_FLOATING;
+	return layouts[desktop];
+}
+
+void layout_set(unsigned long desktop, Layout layout) {
+	if (desktop < 1 || desktop > number_of_desktops) return;
+	if (layouts[desktop] == layout) return;
+
+	layouts[desktop] = layout;
+	log_message(stdout, LOG_DEBUG, "Desktop %lu layout set to %d", desktop, layout);
+	layout_arrange(desktop);
+}
+
+static bool is_tiled(const Client *c) {
+	return c->alive && !c->fullscreen;
+}
+
+// Places one tile, skipping the configure when nothing would change.
+static void place(Client *c, int x, int y, int width, int height) {
+	width = MAX(1, width - 2 * c->border_width);
+	height = MAX(1, height - 2 * c->border_width);
+
+	if (c->x == x && c->y == y && c->width == width && c->height == height) return;
+	client_move_resize(c, x, y, width, height);
+}
+
+static bool on_desktop(const Client *c, unsigned long desktop) {
+	return !c->sticky && c->desktop == desktop;
+}
+
+// Brings a desktop's tile order up to date: entries for windows that left or
+// stopped tiling are replaced by the last entry, new tiled windows are
+// appended in mapping order. Returns the number of tiles.
+static int sync_order(TileOrder *order, unsigned long desktop) {
+	for (int i = 0; i < order->count;) {
+		Client *c = client_find(order->windows[i]);
+		if (c && is_tiled(c) && on_desktop(c, desktop)) {
+			c->tile = i + 1;
+			i++;
+			continue;
+		}
+		order->windows[i] = order->windows[--order->count];
+	}
+
+	for (Client *c = client_desktop_first(desktop); c; c = c->desktop_next) {
+		if (!is_tiled(c)) continue;
+		if (c->tile > 0 && c->tile <= order->count && order->windows[c->tile - 1] == c->window) continue;
+
+		if (order->count == order->capacity) {
+			int capacity = order->capacity ? order->capacity * 2 : 16;
+			Window *grown = realloc(order->windows, capacity * sizeof(Window));
+			if (!grown) {
+				log_message(stderr, LOG_ERROR, "Failed to grow tile order of desktop %lu", desktop);
+				break;
+			}
+			order->windows = grown;
+			order->capacity = capacity;
+		}
+		order->windows[order->count++] = c->window;
+		c->tile = order->count;
+	}
+
+	return order->count;
+}
+
+static void arrange_master_stack(const TileOrder *order, const Geometry *area) {
+	int count = order->count;
+
+	// A lone window gets the whole monitor.
+	int master_width = count == 1 ? area->width : area->width * master_percent / 100;
+	int stack_count = count - 1;
+
+	for (int index = 0; index < count; index++) {
+		Client *c = client_find(order->windows[index]);
+
+		if (index == 0) {
+			place(c, area->x, area->y, master_width, area->height);
+		} else {
+			// Rows are cut at proportional offsets so they always add up
+			// to the monitor height.
+			int row = index - 1;
+			int y = area->height * row / stack_count;
+			int next_y = area->height * (row + 1) / stack_count;
+			place(c, area->x + master_width, area->y + y, area->width - master_width, next_y - y);
+		}
+	}
+}
+
+static void arrange_grid(const TileOrder *order, const Geometry *area) {
+	int count = order->count;
+	int columns = 1;
+	while (columns * columns < count) columns++;
+	int rows = (count + columns - 1) / columns;
+
+	for (int index = 0; index < count; index++) {
+		Client *c = client_find(order->windows[index]);
+		int row = index / columns;
+		int column = index % columns;
+
+		// Tiles in a short last row share its full width.
+		int row_columns = row == rows - 1 ? count - row * columns : columns;
+
+		int x = area->width * column / row_columns;
+		int next_x = area->width * (column + 1) / row_columns;
+		int y = area->height * row / rows;
+		int next_y = area->height * (row + 1) / rows;
+		place(c, area->x + x, area->y + y, next_x - x, next_y - y);
+	}
+}
+
+void layout_arrange(unsigned long desktop) {
+	Layout layout = layout_get(desktop);
+	if (layout == LAYOUT_FLOATING) return;
+
+	TileOrder *order = &orders[desktop];
+	if (sync_order(order, desktop) == 0) return;
+
+	const Geometry *area = monitor_for_client(client_find(order->windows[0]));
+
+	switch (layout) {
+		case LAYOUT_MASTER_STACK:
+			arrange_master_stack(order, area);
+			break;
+		case LAYOUT_GRID:
+			arrange_grid(order, area);
+			break;
+		case LAYOUT_FLOATING:
+			break;
+	}
+}
@@ -10,8 +10,34 @@
 
 #include "plusminus.h"
 
+// Log records are formatted into a ring buffer and written out by log_flush()
+// when the event loop goes idle, so handlers never block on stdout. The WM is
+// single threaded, so the ring needs no locking. Errors are flushed right away
+// so they are not lost if the WM dies.
+
+#define LOG_RING_SLOTS 256
+#define LOG_RECORD_SIZE 512
+
+typedef struct {
+	FILE *stream;
+	int length;
+	char text[LOG_RECORD_SIZE];
+} LogRecord;
+
+static LogRecord ring[LOG_RING_SLOTS];
+static unsigned int ring_head = 0;
+static unsigned int ring_tail = 0;
+
 static LogLevel max_level = LOG_INFO;
 
+// The formatted date only changes once a second.
+static time_t prefix_second = -1;
+static char prefix_time[24];
+
+// isatty() results for stdout and stderr, -1 until first used.
+static int stdout_tty = -1;
+static int stderr_tty = -1;
+
 static const char* level_strings[] = {
 	"INFO",
 	"DEBUG",
@@ -42,31 +68,80 @@ LogLevel get_log_level_from_env(void) {
 	return max_level;
 }
 
-void log_message(FILE *stream, LogLevel level, const char* format, ...) {
+static int stream_is_tty(FILE *stream) {
+	if (stream == stdout) {
+		if (stdout_tty == -1) stdout_tty = isatty(fileno(stdout));
+		return stdout_tty;
+	}
+	if (stream == stderr) {
+		if (stderr_tty == -1) stderr_tty = isatty(fileno(stderr));
+		return stderr_tty;
+	}
+	return isatty(fileno(stream));
+}
+
+void log_flush(void) {
+	bool wrote_stdout = false;
+	bool wrote_stderr = false;
+
+	while (ring_tail != ring_head) {
+		LogRecord *record = &ring[ring_tail % LOG_RING_SLOTS];
+		fwrite(record->text, 1, record->length, record->stream);
+		if (record->stream == stdout) wrote_stdout = true;
+		else if (record->stream == stderr) wrote_stderr = true;
+		else fflush(record->stream);
+		ring_tail++;
+	}
+
+	if (wrote_stdout) fflush(stdout);
+	if (wrote_stderr) fflush(stderr);
+}
+
+void log_write(FILE *stream, LogLevel level, const char* format, ...) {
 	if (max_level < level) return;
 
+	if (ring_head - ring_tail == LOG_RING_SLOTS) {
+		log_flush();
+	}
+
 	struct timeval tv;
 	gettimeofday(&tv, NULL);
-	struct tm* tm_info = localtime(&tv.tv_sec);
-
-	char time_str[24];
-	strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
+	if (tv.tv_sec != prefix_second) {
+		struct tm* tm_info = localtime(&tv.tv_sec);
+		strftime(prefix_time, sizeof(prefix_time), "%Y-%m-%d %H:%M:%S", tm_info);
+		prefix_second = tv.tv_sec;
+	}
 
-	const char *color = isatty(fileno(stream)) ? level_colors[level] : "";
-	const char *reset = isatty(fileno(stream)) ? COLOR_RESET : "";
+	int tty = stream_is_tty(stream);
+	const char *color = tty ? level_colors[level] : "";
+	const char *reset = tty ? COLOR_RESET : "";
 
-	const char* log_format = "%s[%s.%03d] [%-5s] ";
-	fprintf(stream, log_format,
+	// Long messages are truncated, keeping room for the reset sequence and
+	// the newline.
+	LogRecord *record = &ring[ring_head % LOG_RING_SLOTS];
+	size_t size = sizeof(record->text) - sizeof(COLOR_RESET) - 1;
+	int length = snprintf(record->text, size, "%s[%s.%03d] [%-5s] ",
 			color,
-			time_str,
+			prefix_time,
 			(int)(tv.tv_usec / 1000),
 			level_strings[level]);
+	if (length < 0) length = 0;
+	if ((size_t)length >= size) length = size - 1;
 
 	va_list args;
 	va_start(args, format);
-	vfprintf(stream, format, args);
+	int n = vsnprintf(record->text + length, size - length, format, args);
 	va_end(args);
 
-	fprintf(stream, "%s\n", reset);
-	fflush(stream);
+	if (n > 0) length += n;
+	if ((size_t)length >= size) length = size - 1;
+	length += sprintf(record->text + length, "%s\n", reset);
+
+	record->stream = stream;
+	record->length = length;
+	ring_head++;
+
+	if (level == LOG_ERROR) {
+		log_flush();
+	}
 }
@@ -2,28 +2,31 @@
 //        still persists.
 // FIXME: Some of the windows/modals that open are 1x1px.
 // TODO:  Refactor some of the stuff in main.c into separate file.
-// TODO:  Add a CPU/memory widget to status bar.
 // TODO:  Add a pulseaudio widget to the status bar.
 // TODO:  Check for additional hints that can be used.
 //        https://specifications.freedesktop.org/wm-spec/latest/.
-// TODO:  Add alt+tab (windows) and mod+tab (desktops).
+
+#define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include <pthread.h>
 #include <unistd.h>
-#include <sys/wait.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
+#include <X11/Xutil.h>
 #include <X11/keysym.h>
 #include <X11/XF86keysym.h>
-#include <X11/XKBlib.h>
 #include <X11/cursorfont.h>
-#include <X11/Xft/Xft.h>
 
 #include "plusminus.h"
 #include "config.h"
@@ -31,21 +34,16 @@
 Display *dpy;
 static Window root;
 Window active_window = None;
-static XWindowAttributes attr;
 static XButtonEvent start;
+static struct { int x, y, width, height; } drag_origin;
+static struct { bool pending; int x, y, width, height; } drag_target;
+static long long drag_last_configure = 0;
+static struct { bool visible; int x, y, width, height, border_width; } drag_outline;
+static bool drag_server_grabbed = false;
+static GC outline_gc;
 static XEvent ev;
 static int screen;
 
-// Fullscreen state tracking.
-static Window fullscreen_window = None;
-static int fullscreen_x, fullscreen_y, fullscreen_width, fullscreen_height;
-
-MaximizeState vmaximize_windows[MAX_MAXIMIZE_WINDOWS];
-int vmaximize_count = 0;
-
-MaximizeState hmaximize_windows[MAX_MAXIMIZE_WINDOWS];
-int hmaximize_count = 0;
-
 unsigned long number_of_desktops = 9;
 unsigned long current_desktop = 1;
 unsigned long active_border;
@@ -57,13 +55,9 @@ static Cursor cursor_default;
 static Cursor cursor_move;
 static Cursor cursor_resize;
 
-static Visual *visual;
-static Colormap colormap;
-static XftDraw *xft_draw;
-static XftFont *xft_font;
-static XftColor xft_color;
-static XGlyphInfo extents;
+static int desktop_segment;
 
+static Atom WM_STATE;
 static Atom _NET_WM_DESKTOP;
 static Atom _NET_CURRENT_DESKTOP;
 static Atom _NET_NUMBER_OF_DESKTOPS;
@@ -72,46 +66,102 @@ static Atom _NET_WM_STATE;
 static Atom _NET_WM_STATE_FULLSCREEN;
 static Atom _NET_ACTIVE_WINDOW;
 
-static int ignore_x_error(Display *dpy, XErrorEvent *err) {
-	(void)dpy;
-	(void)err;
+// Errors are reported asynchronously, so a request against a window that has
+// already been destroyed never stalls the event loop. A BadWindow for a client
+// marks it dead until its DestroyNotify removes it from the registry.
+static int x_error_handler(Display *dpy, XErrorEvent *err) {
+	if (err->error_code == BadWindow) {
+		Client *c = client_find(err->resourceid);
+		if (c && c->alive) {
+			c->alive = false;
+			log_message(stdout, LOG_DEBUG, "Window 0x%lx is gone (request %d, serial %lu)", err->resourceid, err->request_code, err->serial);
+		}
+		return 0;
+	}
+
+	char text[128];
+	XGetErrorText(dpy, err->error_code, text, sizeof(text));
+	log_message(stderr, LOG_WARNING, "X error: %s (request %d, resource 0x%lx, serial %lu)", text, err->request_code, err->resourceid, err->serial);
 	return 0;
 }
 
-static void force_display_redraw(void) {
-	XClearArea(dpy, root, 0, 0, 1, 1, True);
-	XFlush(dpy);
+long long monotonic_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
-void execute_shortcut(const char *command) {
-	if (!command || strlen(command) == 0) {
-		log_message(stderr, LOG_WARNING, "Empty command provided to execute_shortcut");
-		return;
+static void drag_apply(Client *c) {
+	client_move_resize(c, drag_target.x, drag_target.y, drag_target.width, drag_target.height);
+	drag_target.pending = false;
+	drag_last_configure = monotonic_ns();
+}
+
+// Outlines are drawn with GXxor on the root window including inferiors, so
+// drawing the same rectangle a second time erases it again.
+static void toggle_outline(int x, int y, int width, int height, int border_width) {
+	XDrawRectangle(dpy, root, outline_gc, x, y, width + 2 * border_width - 1, height + 2 * border_width - 1);
+}
+
+// The drawn rectangle and border width are kept with the outline, so it can
+// be erased after the dragged client is gone.
+static void show_outline(Client *c) {
+	if (drag_outline.visible) {
+		toggle_outline(drag_outline.x, drag_outline.y, drag_outline.width, drag_outline.height, drag_outline.border_width);
 	}
 
-	pid_t pid = fork();
-	if (pid == -1) {
-		log_message(stderr, LOG_ERROR, "Failed to fork process for command: %s", command);
-		return;
+	drag_outline.x = drag_target.x;
+	drag_outline.y = drag_target.y;
+	drag_outline.width = drag_target.width;
+	drag_outline.height = drag_target.height;
+	drag_outline.border_width = c->border_width;
+	drag_outline.visible = true;
+	toggle_outline(drag_outline.x, drag_outline.y, drag_outline.width, drag_outline.height, drag_outline.border_width);
+}
+
+static void hide_outline(void) {
+	if (!drag_outline.visible) return;
+	toggle_outline(drag_outline.x, drag_outline.y, drag_outline.width, drag_outline.height, drag_outline.border_width);
+	drag_outline.visible = false;
+}
+
+// Ends a drag: erases the outline and releases the server grab whether or not
+// the dragged window still exists.
+static void drag_end(void) {
+	hide_outline();
+	if (drag_server_grabbed) {
+		XUngrabServer(dpy);
+		drag_server_grabbed = false;
 	}
+	drag_target.pending = false;
+	start.subwindow = None;
+	spatial_pin(None);
+}
+
+// Milliseconds until a drag position held back by drag_rate may be applied,
+// or -1 when nothing is pending. Used as the poll timeout.
+static int drag_flush_timeout(void) {
+	if (!drag_target.pending || wireframe_drag || drag_rate == 0) return -1;
+
+	long long remaining = drag_last_configure + 1000000000LL / drag_rate - monotonic_ns();
+	if (remaining <= 0) return 0;
+	return (int)(remaining / 1000000) + 1;
+}
+
+static void drag_flush(void) {
+	if (drag_flush_timeout() != 0) return;
 
-	if (pid == 0) {
-		execl("/bin/sh", "sh", "-c", command, (char *)NULL);
-		log_message(stderr, LOG_ERROR, "Failed to execute command: %s", command);
-		exit(1);
+	Client *c = client_find(start.subwindow);
+	if (c) {
+		drag_apply(c);
 	} else {
-		log_message(stdout, LOG_DEBUG, "Executed command in background: %s", command);
+		drag_target.pending = false;
 	}
 }
 
 int window_exists(Window w) {
-	if (w == None) return 0;
-	XErrorHandler old = XSetErrorHandler(ignore_x_error);
-	XWindowAttributes attr;
-	Status s = XGetWindowAttributes(dpy, w, &attr);
-	XSync(dpy, False);
-	XSetErrorHandler(old);
-	return s != 0;
+	Client *c = client_find(w);
+	return c && c->alive;
 }
 
 static void set_active_window_property(Window window) {
@@ -120,46 +170,56 @@ static void set_active_window_property(Window window) {
 	} else {
 		XDeleteProperty(dpy, root, _NET_ACTIVE_WINDOW);
 	}
-	XFlush(dpy);
 }
 
-// Helper functions for maximize state management.
-int find_vmaximize_window(Window window) {
-	for (int i = 0; i < vmaximize_count; i++) {
-		if (vmaximize_windows[i].window == window) {
-			return i;
-		}
-	}
-	return -1;
+static void set_wm_state(Window window, long state) {
+	long data[] = { state, None };
+	XChangeProperty(dpy, window, WM_STATE, WM_STATE, 32, PropModeReplace, (unsigned char *)data, 2);
 }
 
-int find_hmaximize_window(Window window) {
-	for (int i = 0; i < hmaximize_count; i++) {
-		if (hmaximize_windows[i].window == window) {
-			return i;
+// Hides a client that is not on the current desktop. SWITCH_PARK leaves it
+// mapped and moves it off-screen, so the client keeps its rendered contents
+// and does not have to repaint when it is shown again.
+void hide_client(Client *c) {
+	if (desktop_switch_mode == SWITCH_PARK) {
+		if (c->parked) return;
+		XMoveWindow(dpy, c->window, PARKED_X, c->y);
+		c->parked = true;
+		log_message(stdout, LOG_DEBUG, "Parked window 0x%lx off-screen", c->window);
+
+		// A parked window stays mapped, so the server would leave the
+		// keyboard focus on it.
+		if (c->window == active_window) {
+			XSetInputFocus(dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
+			update_borders(None);
 		}
+	} else {
+		if (!c->mapped) return;
+		XUnmapWindow(dpy, c->window);
+		c->mapped = false;
+		log_message(stdout, LOG_DEBUG, "Unmapping window 0x%lx", c->window);
 	}
-	return -1;
+
+	spatial_invalidate(c);
+	set_wm_state(c->window, IconicState);
 }
 
-void remove_vmaximize_window(Window window) {
-	int index = find_vmaximize_window(window);
-	if (index >= 0) {
-		for (int i = index; i < vmaximize_count - 1; i++) {
-			vmaximize_windows[i] = vmaximize_windows[i + 1];
-		}
-		vmaximize_count--;
+void show_client(Client *c) {
+	if (c->mapped && !c->parked) return;
+
+	if (!c->mapped) {
+		XMapWindow(dpy, c->window);
+		c->mapped = true;
 	}
-}
 
-void remove_hmaximize_window(Window window) {
-	int index = find_hmaximize_window(window);
-	if (index >= 0) {
-		for (int i = index; i < hmaximize_count - 1; i++) {
-			hmaximize_windows[i] = hmaximize_windows[i + 1];
-		}
-		hmaximize_count--;
+	if (c->parked) {
+		XMoveWindow(dpy, c->window, c->x, c->y);
+		c->parked = false;
 	}
+
+	spatial_invalidate(c);
+	set_wm_state(c->window, NormalState);
+	log_message(stdout, LOG_DEBUG, "Showing window 0x%lx (desktop %lu)", c->window, c->sticky ? 0 : c->desktop);
 }
 
 void update_borders(Window new_active) {
@@ -189,142 +249,116 @@ void update_borders(Window new_active) {
 		}
 	}
 
+	if (active_window != new_active) {
+		ipc_notify("focus 0x%lx", new_active);
+	}
+
+	// Previews while cycling leave the focus order alone.
+	Client *focused = client_find(new_active);
+	if (focused && !cycle_active()) {
+		client_mru_touch(focused);
+	}
+
 	active_window = new_active;
 	set_active_window_property(active_window);
 }
 
-void add_to_client_list(Window window) {
-	Atom type;
-	int format;
-	unsigned long nitems, bytes_after;
-	unsigned char *data = NULL;
-
-	if (XGetWindowProperty(dpy, root, _NET_CLIENT_LIST, 0, 1024, False, XA_WINDOW, &type, &format, &nitems, &bytes_after, &data) == Success) {
-		Window *windows;
-		if (data) {
-			windows = realloc(data, (nitems + 1) * sizeof(Window));
-		} else {
-			windows = malloc(sizeof(Window));
-			nitems = 0;
-		}
-		windows[nitems] = window;
-		XChangeProperty(dpy, root, _NET_CLIENT_LIST, XA_WINDOW, 32, PropModeReplace, (unsigned char *)windows, nitems + 1);
-		free(windows);
+void set_window_desktop(Window window, unsigned long desktop) {
+	Client *c = client_find(window);
+	if (c) {
+		unsigned long previous_desktop = c->sticky ? 0 : c->desktop;
+		client_set_desktop(c, desktop);
+
+		// Both desktops lose or gain a tile.
+		if (previous_desktop != desktop) layout_arrange(previous_desktop);
+		layout_arrange(desktop);
 	}
-}
 
-void remove_from_client_list(Window window) {
-	Atom type;
-	int format;
-	unsigned long nitems, bytes_after;
-	unsigned char *data = NULL;
+	unsigned long value = desktop;
+	XChangeProperty(dpy, window, _NET_WM_DESKTOP, XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&value, 1);
+
+	log_message(stdout, LOG_DEBUG, "Window 0x%lx assigned desktop %lu", window, desktop);
+}
 
-	if (XGetWindowProperty(dpy, root, _NET_CLIENT_LIST, 0, 1024, False, XA_WINDOW, &type, &format, &nitems, &bytes_after, &data) == Success) {
-		if (type == XA_WINDOW) {
-			Window *windows = (Window *)data;
-			int found = 0;
+// Moves a managed window to another desktop and hides or shows it depending on
+// whether that desktop is the visible one.
+void move_window_to_desktop(Window window, unsigned long desktop) {
+	Client *c = client_find(window);
+	if (!c || !c->alive) return;
 
-			for (unsigned long i = 0; i < nitems; i++) {
-				if (windows[i] == window) {
-					found = 1;
-					for (unsigned long j = i; j < nitems - 1; j++) {
-						windows[j] = windows[j + 1];
-					}
-					break;
-				}
-			}
+	unsigned long previous_desktop = get_window_desktop(window);
+	set_window_desktop(window, desktop);
+	log_message(stdout, LOG_DEBUG, "Moved window 0x%lx from desktop %lu to desktop %lu", window, previous_desktop, desktop);
 
-			if (found) {
-				XChangeProperty(dpy, root, _NET_CLIENT_LIST, XA_WINDOW, 32, PropModeReplace, (unsigned char *)windows, nitems - 1);
-			}
-		}
-		if (data) XFree(data);
+	if (desktop == current_desktop) {
+		show_client(c);
+		XSetWindowBorder(dpy, window, window == active_window ? active_border : inactive_border);
+	} else {
+		hide_client(c);
+		XSetWindowBorder(dpy, window, inactive_border);
 	}
 }
 
-void set_window_desktop(Window window, unsigned long desktop) {
-	Atom type;
-	int format;
-	unsigned long nitems, bytes_after;
-	unsigned char *data = NULL;
+// Raises and focuses a managed window, switching to its desktop first if it
+// is not on the visible one.
+void activate_window(Window window) {
+	if (window == None || !window_exists(window)) return;
 
-	if (XGetWindowProperty(dpy, window, _NET_WM_DESKTOP, 0, 1, False, XA_CARDINAL, &type, &format, &nitems, &bytes_after, &data) == Success) {
-		if (data) XFree(data);
+	unsigned long window_desktop = get_window_desktop(window);
+	if (window_desktop != 0 && window_desktop != current_desktop) {
+		switch_desktop(window_desktop);
 	}
 
-	unsigned long value = desktop;
-	XChangeProperty(dpy, window, _NET_WM_DESKTOP, XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&value, 1);
-
-	log_message(stdout, LOG_DEBUG, "Window 0x%lx assigned desktop %lu", window, desktop);
+	XRaiseWindow(dpy, window);
+	XSetInputFocus(dpy, window, RevertToPointerRoot, CurrentTime);
+	update_borders(window);
+	log_message(stdout, LOG_DEBUG, "Activated window 0x%lx on desktop %lu", window, window_desktop);
 }
 
 unsigned long get_window_desktop(Window w) {
-	if (w == None || !window_exists(w)) {
-		// Default to desktop 0 for invalid windows.
+	Client *c = client_find(w);
+	if (!c || !c->alive) {
+		// Default to desktop 0 for unmanaged or invalid windows.
 		// This is a workaround to avoid crashing the program.
-		return 0; 
+		return 0;
 	}
 
-	Atom type;
-	int format;
-	unsigned long nitems, bytes_after;
-	unsigned char *data = NULL;
-	unsigned long desktop = 0;
-
-	if (XGetWindowProperty(dpy, w, _NET_WM_DESKTOP, 0, 1, False, XA_CARDINAL, &type, &format, &nitems, &bytes_after, &data) == Success) {
-		if (data && nitems > 0 && type == XA_CARDINAL && format == 32) {
-			desktop = *((unsigned long *)data);
-		}
-		if (data) XFree(data);
-	}
-
-	return desktop;
+	return c->sticky ? 0 : c->desktop;
 }
 
 void switch_desktop(unsigned long desktop) {
 	if (desktop < 1 || desktop > number_of_desktops) return;
 
+	unsigned long previous_desktop = current_desktop;
 	current_desktop = desktop;
+	spatial_invalidate(NULL);
 
 	unsigned long value = desktop;
 	XChangeProperty(dpy, root, _NET_CURRENT_DESKTOP, XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&value, 1);
 
-	Atom type;
-	int format;
-	unsigned long nitems, bytes_after;
-	unsigned char *data = NULL;
+	// Only the outgoing and incoming desktops are touched; sticky windows stay
+	// visible. The event loop flushes everything as one batch.
+	if (previous_desktop != desktop) {
+		for (Client *c = client_desktop_first(previous_desktop); c; c = c->desktop_next) {
+			if (c->alive) hide_client(c);
+		}
+	}
 
 	Window first_window_on_desktop = None;
-	if (XGetWindowProperty(dpy, root, _NET_CLIENT_LIST, 0, 1024, False, XA_WINDOW, &type, &format, &nitems, &bytes_after, &data) == Success) {
-		if (type == XA_WINDOW && format == 32) {
-			Window *windows = (Window *)data;
-
-			for (unsigned long i = 0; i < nitems; i++) {
-				Window w = windows[i];
-
-				if (!window_exists(w)) {
-					log_message(stdout, LOG_DEBUG, "Window 0x%lx no longer exists, skipping", w);
-					continue;
-				}
-
-				unsigned long window_desktop = get_window_desktop(w);
-				log_message(stdout, LOG_DEBUG, "Processing window 0x%lx on desktop %lu (current: %lu)", w, window_desktop, current_desktop);
-
-				if (window_desktop == 0 || window_desktop == current_desktop) {
-					log_message(stdout, LOG_DEBUG, "Mapping window 0x%lx (desktop %lu)", w, window_desktop);
-					XMapWindow(dpy, w);
-					if (first_window_on_desktop == None && window_desktop != 0) {
-						first_window_on_desktop = w;
-					}
-				} else {
-					log_message(stdout, LOG_DEBUG, "Unmapping window 0x%lx", w);
-					XUnmapWindow(dpy, w);
-				}
-			}
+	for (Client *c = client_desktop_first(desktop); c; c = c->desktop_next) {
+		if (!c->alive) {
+			log_message(stdout, LOG_DEBUG, "Window 0x%lx no longer exists, skipping", c->window);
+			continue;
+		}
 
-			XFlush(dpy);
+		show_client(c);
+		if (first_window_on_desktop == None) {
+			first_window_on_desktop = c->window;
 		}
-		if (data) XFree(data);
+	}
+
+	for (Client *c = client_desktop_first(0); c; c = c->desktop_next) {
+		if (c->alive) show_client(c);
 	}
 
 	if (active_window != None) {
@@ -350,138 +384,485 @@ void switch_desktop(unsigned long desktop) {
 	}
 
 	log_message(stdout, LOG_DEBUG, "Switched to desktop %lu", desktop);
-	force_display_redraw();
+	ipc_notify("desktop %lu", desktop);
+	cycle_desktop_visited(desktop);
+	draw_desktop_number();
 }
 
 void draw_desktop_number(void) {
-	char text[50];
+	char text[24];
 	snprintf(text, sizeof(text), "%lu", current_desktop);
+	bar_set_segment(desktop_segment, text);
+	bar_render();
+}
+
+static void set_fullscreen(Window window, int fullscreen) {
+	Client *c = client_find(window);
+	if (!c || c->fullscreen == (fullscreen != 0)) return;
+
+	if (fullscreen) {
+		c->fullscreen_saved = (Geometry){ c->x, c->y, c->width, c->height };
+
+		const Geometry *monitor = monitor_for_client(c);
+		client_set_border_width(c, 0);
+		client_move_resize(c, monitor->x, monitor->y, monitor->width, monitor->height);
 
-	XftTextExtentsUtf8(dpy, xft_font, (FcChar8 *)text, strlen(text), &extents);
-	XClearArea(dpy, root, DisplayWidth(dpy, screen) - 30, 10, extents.width + 10, extents.height + 10, False);
+		XChangeProperty(dpy, window, _NET_WM_STATE, XA_ATOM, 32, PropModeReplace, (unsigned char *)&_NET_WM_STATE_FULLSCREEN, 1);
+		c->fullscreen = true;
 
-	XftColor blue_color;
-	XRenderColor render_blue = {0, 0, 0xFFFF, 0xFFFF};
-	XftColorAllocValue(dpy, DefaultVisual(dpy, screen), DefaultColormap(dpy, screen), &render_blue, &blue_color);
+		log_message(stdout, LOG_DEBUG, "Window 0x%lx set to fullscreen", window);
+	} else {
+		client_set_border_width(c, border_size);
+		Geometry *saved = &c->fullscreen_saved;
+		client_move_resize(c, saved->x, saved->y, saved->width, saved->height);
 
-	XftDrawRect(xft_draw, &blue_color, DisplayWidth(dpy, screen) - 30, 10, extents.width + 10, extents.height + 10);
-	XftDrawStringUtf8(xft_draw, &xft_color, xft_font, DisplayWidth(dpy, screen) - 25, 10 + xft_font->ascent, (FcChar8 *)text, strlen(text));
+		XDeleteProperty(dpy, window, _NET_WM_STATE);
+		c->fullscreen = false;
+
+		log_message(stdout, LOG_DEBUG, "Window 0x%lx restored from fullscreen", window);
+	}
+
+	// The window leaves or rejoins its desktop's tiles.
+	if (!c->sticky) layout_arrange(c->desktop);
 
-	XftColorFree(dpy, DefaultVisual(dpy, screen), DefaultColormap(dpy, screen), &blue_color);
 	XFlush(dpy);
 }
 
-void draw_current_time(void) {
-	int width = DisplayWidth(dpy, screen) - 40;
-	int x = 10;
-	int y = 10;
-	char text[50];
+void toggle_fullscreen(Window window) {
+	if (window == None || !window_exists(window)) {
+		log_message(stdout, LOG_DEBUG, "No valid window to toggle fullscreen");
+		return;
+	}
+
+	if (client_find(window)->fullscreen) {
+		set_fullscreen(window, 0);
+	} else {
+		set_fullscreen(window, 1);
+	}
+}
 
-	time_t now = time(NULL);
-	struct tm *tm_info = localtime(&now);
-	strftime(text, sizeof(text), time_format, tm_info);
+// Refreshes the widgets that are due and arms the timer for the next
+// boundary. The timer is absolute on the wall clock, so it fires exactly when
+// the next widget is due and not a second before.
+static void schedule_widgets(int timer_fd) {
+	widgets_update(time(NULL));
+
+	struct itimerspec next = {
+		.it_interval = { .tv_sec = 0, .tv_nsec = 0 },
+		.it_value = { .tv_sec = widgets_next_wakeup(), .tv_nsec = 0 },
+	};
+	if (next.it_value.tv_sec == 0) return;
+
+	// The timer is cancelled when the clock is set, so a jump backwards
+	// reschedules the widgets instead of freezing them until the old deadline.
+	timerfd_settime(timer_fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &next, NULL);
+}
 
-	XftTextExtentsUtf8(dpy, xft_font, (FcChar8 *)text, strlen(text), &extents);
-	/* XClearArea(dpy, root, x, y, extents.width, extents.height, False); */
-	XClearArea(dpy, root, 0, 0,  DisplayWidth(dpy, screen) - 30, 50, False);
-	XftDrawStringUtf8(xft_draw, &xft_color, xft_font, width - (xft_font->max_advance_width * strlen(text)) - x, y + xft_font->ascent, (FcChar8 *)text, strlen(text));
+static void handle_event(void);
 
-	XFlush(dpy);
+// Handles the event in `ev` and records how long it took.
+static void dispatch_event(void) {
+	long long started = monotonic_ns();
+	profile_enter(ev.type);
+	handle_event();
+	profile_leave();
+	stats_record(ev.type, monotonic_ns() - started);
 }
 
-static void* expose_timer_thread(void* arg) {
-	(void)arg;
+// Feeds one journal event through the handler. Events the server sends in
+// response are dropped, the journal already holds what the recorded session
+// received.
+static void replay_event(const XEvent *e) {
+	ev = *e;
+	dispatch_event();
+}
 
-	for(;;) {
-		sleep(1);
+// Reads the first 32-bit item of a property, false when it isn't set.
+static bool get_long_property(Window window, Atom property, Atom type, long *value) {
+	Atom actual_type;
+	int actual_format;
+	unsigned long items, after;
+	unsigned char *data = NULL;
 
-		if (dpy != NULL) {
-			XEvent event;
-			memset(&event, 0, sizeof(event));
+	bool found = XGetWindowProperty(dpy, window, property, 0, 1, False, type, &actual_type, &actual_format, &items, &after, &data) == Success
+		&& actual_type == type && actual_format == 32 && items == 1;
+	if (found) *value = ((long *)data)[0];
+	if (data) XFree(data);
+	return found;
+}
+
+// Takes over the windows that already exist when the WM starts, for example
+// after a restart. Viewable windows and the ones a previous instance hid
+// (IconicState) are managed again on the desktop their _NET_WM_DESKTOP names.
+static void adopt_windows(void) {
+	Window root_return, parent_return, *children = NULL;
+	unsigned int count = 0;
+	if (!XQueryTree(dpy, root, &root_return, &parent_return, &children, &count)) return;
+
+	for (unsigned int i = 0; i < count; i++) {
+		Window window = children[i];
+		XWindowAttributes attr;
+		if (window == bar_window() || !XGetWindowAttributes(dpy, window, &attr) || attr.override_redirect) continue;
 
-			event.type = Expose;
-			event.xexpose.window = root;
-			event.xexpose.x = 0;
-			event.xexpose.y = 0;
-			event.xexpose.width = 1;
-			event.xexpose.height = 1;
-			event.xexpose.count = 0;
+		long state = WithdrawnState;
+		get_long_property(window, WM_STATE, WM_STATE, &state);
+		if (attr.map_state != IsViewable && state != IconicState) continue;
 
-			// This is thread-safe - XSendEvent is designed for this.
-			XSendEvent(dpy, root, False, ExposureMask, &event);
-			XFlush(dpy);
+		long desktop = current_desktop;
+		if (!get_long_property(window, _NET_WM_DESKTOP, XA_CARDINAL, &desktop) || desktop < 0 || (unsigned long)desktop > number_of_desktops) {
+			desktop = current_desktop;
 		}
+
+		Client *c = client_add(window);
+		if (!c) continue;
+
+		// A window parked by a previous instance comes back at the left edge.
+		bool parked = attr.x == PARKED_X;
+		client_set_geometry(c, parked ? 0 : attr.x, attr.y, attr.width, attr.height, attr.border_width);
+		client_set_border_width(c, border_size);
+		client_set_desktop(c, desktop);
+		XSetWindowBorder(dpy, window, desktop == 0 ? sticky_inactive_border : inactive_border);
+		XSelectInput(dpy, window, EnterWindowMask | LeaveWindowMask);
+		c->mapped = attr.map_state == IsViewable;
+		c->parked = parked;
+
+		if (desktop == 0 || (unsigned long)desktop == current_desktop) {
+			show_client(c);
+		} else {
+			hide_client(c);
+		}
+		log_message(stdout, LOG_DEBUG, "Adopted window 0x%lx on desktop %ld", window, desktop);
+	}
+	if (children) XFree(children);
+
+	client_publish_list();
+	for (unsigned long desktop = 1; desktop <= number_of_desktops; desktop++) {
+		layout_arrange(desktop);
 	}
-	return NULL;
 }
 
-static int is_fullscreen(Window window) {
-	Atom type;
-	int format;
-	unsigned long nitems, bytes_after;
-	unsigned char *data = NULL;
-	int fullscreen = 0;
-
-	if (XGetWindowProperty(dpy, window, _NET_WM_STATE, 0, 1024, False, XA_ATOM, &type, &format, &nitems, &bytes_after, &data) == Success) {
-		if (data && type == XA_ATOM && format == 32) {
-			Atom *states = (Atom *)data;
-			for (unsigned long i = 0; i < nitems; i++) {
-				if (states[i] == _NET_WM_STATE_FULLSCREEN) {
-					fullscreen = 1;
+// Follows a change of the monitor layout: the bar moves to the primary
+// monitor and every tiled desktop is arranged again.
+static void monitors_changed(void) {
+	bar_place(monitor_primary());
+	spatial_invalidate(NULL);
+	for (unsigned long desktop = 1; desktop <= number_of_desktops; desktop++) {
+		layout_arrange(desktop);
+	}
+}
+
+static void handle_event(void) {
+	switch (ev.type) {
+		case MapRequest:
+			{
+				Window window = ev.xmaprequest.window;
+				Client *c = client_add(window);
+				if (!c) break;
+
+				client_set_border_width(c, border_size);
+				XSetWindowBorder(dpy, window, inactive_border);
+
+				MapInfo info;
+				if (fetch_map_info(root, window, &info)) {
+					client_set_geometry(c, info.x, info.y, info.width, info.height, border_size);
+					XSelectInput(dpy, window, EnterWindowMask | LeaveWindowMask);
+
+					// Tiled desktops place the window themselves.
+					if (info.pointer_valid && layout_get(current_desktop) == LAYOUT_FLOATING) {
+						// Kept inside the monitor under the cursor.
+						const Geometry *monitor = monitor_at(info.pointer_x, info.pointer_y);
+						int new_x = info.pointer_x - (info.width / 2);
+						int new_y = info.pointer_y - (info.height / 2);
+
+						if (new_x + info.width > monitor->x + monitor->width) new_x = monitor->x + monitor->width - info.width;
+						if (new_y + info.height > monitor->y + monitor->height) new_y = monitor->y + monitor->height - info.height;
+						if (new_x < monitor->x) new_x = monitor->x;
+						if (new_y < monitor->y) new_y = monitor->y;
+
+						client_move(c, new_x, new_y);
+						log_message(stdout, LOG_DEBUG, "Positioned new window 0x%lx at cursor (%d, %d)", window, info.pointer_x, info.pointer_y);
+					}
+				}
+
+				// Tiles are arranged before the map so the window appears in
+				// its tile instead of jumping there.
+				set_window_desktop(window, current_desktop);
+
+				XMapWindow(dpy, window);
+				set_wm_state(window, NormalState);
+				c->mapped = true;
+				c->parked = false;
+				log_message(stdout, LOG_DEBUG, "Window 0x%lx mapped", window);
+
+				// Make the new window active and focused.
+				XRaiseWindow(dpy, window);
+				XSetInputFocus(dpy, window, RevertToPointerRoot, CurrentTime);
+				update_borders(window);
+				log_message(stdout, LOG_DEBUG, "Window 0x%lx raised and focused", window);
+
+				// Update border color based on desktop (sticky windows get violet border).
+				unsigned long border_color;
+				if (get_window_desktop(window) == 0) {
+					border_color = sticky_active_border;
+				} else {
+					border_color = active_border;
+				}
+				XSetWindowBorder(dpy, window, border_color);
+			} break;
+
+		case DestroyNotify:
+			{
+				if (ev.xdestroywindow.window == active_window) {
+					update_borders(None);
+					log_message(stdout, LOG_DEBUG, "Window 0x%lx destroyed", ev.xdestroywindow.window);
+				}
+
+				Client *c = client_find(ev.xdestroywindow.window);
+				unsigned long desktop = c && !c->sticky ? c->desktop : 0;
+
+				if (ev.xdestroywindow.window == start.subwindow) drag_end();
+
+				// Any saved fullscreen or maximize geometry goes with the client.
+				client_remove(ev.xdestroywindow.window);
+				layout_arrange(desktop);
+			} break;
+
+		case ConfigureNotify:
+			{
+				if (ev.xconfigure.window == root) {
+					if (monitor_update(&ev)) monitors_changed();
 					break;
 				}
-			}
-		}
-		if (data) XFree(data);
-	}
+				client_configure_notify(&ev.xconfigure);
+			} break;
 
-	return fullscreen;
-}
+		case UnmapNotify:
+			{
+				if (ev.xunmap.window == start.subwindow) drag_end();
 
-static void set_fullscreen(Window window, int fullscreen) {
-	if (fullscreen) {
-		XWindowAttributes attr;
-		XGetWindowAttributes(dpy, window, &attr);
-		fullscreen_x = attr.x;
-		fullscreen_y = attr.y;
-		fullscreen_width = attr.width;
-		fullscreen_height = attr.height;
+				Client *c = client_find(ev.xunmap.window);
+				if (c) {
+					c->mapped = false;
+					spatial_invalidate(c);
+				}
+				log_message(stdout, LOG_DEBUG, "Window 0x%lx unmapped", ev.xunmap.window);
+			} break;
 
-		XSetWindowBorderWidth(dpy, window, 0);
-		XMoveResizeWindow(dpy, window, 0, 0, DisplayWidth(dpy, screen), DisplayHeight(dpy, screen));
+		case FocusIn:
+			{
+				if (ev.xfocus.window != root) {
+					update_borders(ev.xfocus.window);
+				}
+			}
+			break;
 
-		XChangeProperty(dpy, window, _NET_WM_STATE, XA_ATOM, 32, PropModeReplace, (unsigned char *)&_NET_WM_STATE_FULLSCREEN, 1);
-		fullscreen_window = window;
+		case FocusOut:
+			{
+				if (ev.xfocus.window == active_window) {
+					update_borders(None);
+				}
+			} break;
+
+		case EnterNotify:
+			{
+				if (follow_focus) {
+					// Parked windows stay mapped off-screen, but are hidden
+					// as far as focus is concerned.
+					Window entered_window = ev.xcrossing.window;
+					Client *c = client_find(entered_window);
+					if (entered_window != root && ev.xcrossing.mode == NotifyNormal && !(c && c->parked)) {
+						if (entered_window != None && entered_window != active_window) {
+							XRaiseWindow(dpy, entered_window);
+							XSetInputFocus(dpy, entered_window, RevertToPointerRoot, CurrentTime);
+							update_borders(entered_window);
+						}
+					}
+				}
+			} break;
+
+		case KeyPress:
+			{
+				if (cycle_key_press(&ev.xkey)) break;
+				keys_dispatch(&ev.xkey);
+			} break;
+
+		case KeyRelease:
+			{
+				keys_release(&ev.xkey);
+				cycle_key_release(&ev.xkey);
+			} break;
+
+		case MappingNotify:
+			{
+				XMappingEvent *mapping = &ev.xmapping;
+				XRefreshKeyboardMapping(mapping);
+				if (mapping->request == MappingKeyboard || mapping->request == MappingModifier) {
+					keys_grab();
+				}
+			} break;
+
+		case ButtonPress:
+			{
+				if (ev.xbutton.subwindow != None) {
+					Client *c = client_find(ev.xbutton.subwindow);
+					if (c && !c->parked && (ev.xbutton.state & MODKEY)) {
+						drag_origin.x = c->x;
+						drag_origin.y = c->y;
+						drag_origin.width = c->width;
+						drag_origin.height = c->height;
+						start = ev.xbutton;
+
+						// Keep the dragged window out of the spatial index
+						// so its moves don't force rebuilds.
+						spatial_pin(c->window);
+
+						// Raise and focus the window.
+						XRaiseWindow(dpy, ev.xbutton.subwindow);
+						XSetInputFocus(dpy, ev.xbutton.subwindow, RevertToPointerRoot, CurrentTime);
+						update_borders(ev.xbutton.subwindow);
+
+						// The server is grabbed while the outline is shown so
+						// no other client can draw over it and leave XOR trails.
+						if (wireframe_drag) {
+							XGrabServer(dpy);
+							drag_server_grabbed = true;
+							drag_target.x = drag_origin.x;
+							drag_target.y = drag_origin.y;
+							drag_target.width = drag_origin.width;
+							drag_target.height = drag_origin.height;
+							show_outline(c);
+						}
 
-		log_message(stdout, LOG_DEBUG, "Window 0x%lx set to fullscreen", window);
-	} else {
-		XSetWindowBorderWidth(dpy, window, border_size);
-		XMoveResizeWindow(dpy, window, fullscreen_x, fullscreen_y, fullscreen_width, fullscreen_height);
+						// Set appropriate cursor for dragging.
+						if (start.button == 1) {
+							log_message(stdout, LOG_DEBUG, "Setting cursor to move");
+							XDefineCursor(dpy, start.subwindow, cursor_move);
+						} else if (start.button == 3) {
+							log_message(stdout, LOG_DEBUG, "Setting cursor to resize");
+							XDefineCursor(dpy, start.subwindow, cursor_resize);
+						}
+						log_message(stdout, LOG_DEBUG, "MODKEY click on window 0x%lx - dragging enabled", ev.xbutton.subwindow);
+					}
+					XFlush(dpy);
+				}
+			} break;
+
+		case ButtonRelease:
+			{
+				if (start.subwindow != None) {
+					// Apply the last position held back by the drag rate cap
+					// or, in wireframe mode, the only configure of the drag.
+					Client *c = client_find(start.subwindow);
+					hide_outline();
+					if (c && drag_target.pending) {
+						drag_apply(c);
+					}
 
-		XDeleteProperty(dpy, window, _NET_WM_STATE);
-		fullscreen_window = None;
+					// MODKEY drag release: restore cursor.
+					if (c && (start.state & MODKEY)) {
+						XDefineCursor(dpy, start.subwindow, None);
+					}
+					drag_end();
+					XFlush(dpy);
+				}
+			} break;
+
+		case MotionNotify:
+			{
+				// Only the latest pointer position matters, so skip over
+				// motion events that are already queued behind this one.
+				while (event_queued() > 0) {
+					XEvent next;
+					event_peek(&next);
+					if (next.type != MotionNotify) break;
+					event_next(&ev);
+				}
 
-		log_message(stdout, LOG_DEBUG, "Window 0x%lx restored from fullscreen", window);
-	}
+				Client *c = client_find(start.subwindow);
+				if (c && (start.state & MODKEY)) {
+					int xdiff = ev.xmotion.x_root - start.x_root;
+					int ydiff = ev.xmotion.y_root - start.y_root;
+
+					drag_target.x = drag_origin.x + (start.button == 1 ? xdiff : 0);
+					drag_target.y = drag_origin.y + (start.button == 1 ? ydiff : 0);
+					drag_target.width = MAX(50, drag_origin.width  + (start.button == 3 ? xdiff : 0));
+					drag_target.height = MAX(50, drag_origin.height + (start.button == 3 ? ydiff : 0));
+					drag_target.pending = true;
+
+					// Moved windows stick to nearby window and monitor edges.
+					if (start.button == 1) {
+						int outer_width = drag_target.width + 2 * c->border_width;
+						int outer_height = drag_target.height + 2 * c->border_width;
+						drag_target.x = spatial_snap_x(drag_target.x, drag_target.y, outer_width, outer_height);
+						drag_target.y = spatial_snap_y(drag_target.x, drag_target.y, outer_width, outer_height);
+					}
 
-	XFlush(dpy);
-}
+					if (wireframe_drag) {
+						show_outline(c);
+					} else if (drag_rate == 0 || monotonic_ns() - drag_last_configure >= 1000000000LL / drag_rate) {
+						drag_apply(c);
+					}
+				}
+			} break;
+
+		case ClientMessage:
+			{
+				if (ev.xclient.message_type == _NET_WM_STATE) {
+					Atom action = ev.xclient.data.l[0];
+					Atom state = ev.xclient.data.l[1];
+					Window window = ev.xclient.window;
+
+					if (state == _NET_WM_STATE_FULLSCREEN) {
+						if (action == 1) { // _NET_WM_STATE_ADD
+							set_fullscreen(window, 1);
+						} else if (action == 0) { // _NET_WM_STATE_REMOVE
+							set_fullscreen(window, 0);
+						} else if (action == 2) { // _NET_WM_STATE_TOGGLE
+							toggle_fullscreen(window);
+						}
+					}
+				} else if (ev.xclient.message_type == _NET_CURRENT_DESKTOP) {
+					// Pagers and scripts ask for a desktop switch this way.
+					switch_desktop((unsigned long)ev.xclient.data.l[0]);
+				} else if (ev.xclient.message_type == _NET_WM_DESKTOP) {
+					Window window = ev.xclient.window;
+					unsigned long desktop = (unsigned long)ev.xclient.data.l[0];
+					if (window_exists(window) && desktop >= 1 && desktop <= number_of_desktops && get_window_desktop(window) != desktop) {
+						move_window_to_desktop(window, desktop);
+					}
+				} else if (ev.xclient.message_type == _NET_ACTIVE_WINDOW) {
+					activate_window(ev.xclient.data.l[0]);
+				}
+			}
+			break;
 
-static void toggle_fullscreen(Window window) {
-	if (window == None || !window_exists(window)) {
-		log_message(stdout, LOG_DEBUG, "No valid window to toggle fullscreen");
-		return;
-	}
+		case Expose:
+			if (ev.xexpose.window == bar_window()) {
+				bar_expose(&ev.xexpose);
+			}
+			break;
 
-	if (is_fullscreen(window)) {
-		set_fullscreen(window, 0);
-	} else {
-		set_fullscreen(window, 1);
+		default:
+			if (monitor_update(&ev)) monitors_changed();
+			break;
 	}
 }
 
-int main(void) {
+int main(int argc, char **argv) {
+	const char *replay_path = NULL;
+	if (argc == 3 && strcmp(argv[1], "--replay") == 0) {
+		replay_path = argv[2];
+	} else if (argc != 1) {
+		fprintf(stderr, "usage: %s [--replay journal]\n", argv[0]);
+		return 1;
+	}
+
 	set_log_level(get_log_level_from_env());
+	atexit(log_flush);
+#ifdef PROFILE
+	// Registered after log_flush so the report is flushed once it is written.
+	atexit(profile_report);
+#endif
 
 	dpy = XOpenDisplay(NULL);
 	if (!dpy) {
@@ -492,6 +873,8 @@ int main(void) {
 	screen = DefaultScreen(dpy);
 	root = RootWindow(dpy, screen);
 
+	XSetErrorHandler(x_error_handler);
+
 	// Create cursors.
 	cursor_default = XCreateFontCursor(dpy, XC_left_ptr);
 	cursor_move = XCreateFontCursor(dpy, XC_fleur);
@@ -499,55 +882,54 @@ int main(void) {
 
 	XDefineCursor(dpy, root, cursor_default);
 
-	// Set fonts and visual stuff.
-	visual = DefaultVisual(dpy, screen);
-	colormap = DefaultColormap(dpy, screen);
-	xft_draw = XftDrawCreate(dpy, root, visual, colormap);
+	// GC for wireframe drag outlines.
+	XGCValues gc_values;
+	gc_values.function = GXxor;
+	gc_values.subwindow_mode = IncludeInferiors;
+	gc_values.line_width = border_size;
+	gc_values.foreground = WhitePixel(dpy, screen) ^ BlackPixel(dpy, screen);
+	outline_gc = XCreateGC(dpy, root, GCFunction | GCSubwindowMode | GCLineWidth | GCForeground, &gc_values);
 
-	xft_font = XftFontOpenName(dpy, screen, font_name);
-	if (!xft_font) {
-		xft_font = XftFontOpenName(dpy, screen, "monospace-12");
-	}
+	monitor_init(root);
 
-	XRenderColor render_color = {0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF};
-	XftColorAllocValue(dpy, visual, colormap, &render_color, &xft_color);
+	// Status bar, the desktop number sits at the right edge.
+	bar_init(root, font_name);
+	bar_place(monitor_primary());
+	desktop_segment = bar_add_segment(true);
+	widgets_init(widgets, LENGTH(widgets), time_format);
+	draw_desktop_number();
 
 	// Initialize EWMH atoms for multiple desktop support.
-	_NET_WM_DESKTOP = XInternAtom(dpy, "_NET_WM_DESKTOP", False);
-	_NET_CURRENT_DESKTOP = XInternAtom(dpy, "_NET_CURRENT_DESKTOP", False);
-	_NET_NUMBER_OF_DESKTOPS = XInternAtom(dpy, "_NET_NUMBER_OF_DESKTOPS", False);
-	_NET_CLIENT_LIST = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
-	_NET_WM_STATE = XInternAtom(dpy, "_NET_WM_STATE", False);
-	_NET_WM_STATE_FULLSCREEN = XInternAtom(dpy, "_NET_WM_STATE_FULLSCREEN", False);
-	_NET_ACTIVE_WINDOW = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False);
-
-	// Set number of desktops and current desktop.
-	XChangeProperty(dpy, root, _NET_NUMBER_OF_DESKTOPS, XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&number_of_desktops, 1);
-	XChangeProperty(dpy, root, _NET_CURRENT_DESKTOP, XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&current_desktop, 1);
-
-	XUngrabButton(dpy, AnyButton, AnyModifier, root);
-
-	// Grab keys for keybinds.
-	for (unsigned int i = 0; i < LENGTH(keybinds); i++) {
-		KeyCode keycode = XKeysymToKeycode(dpy, keybinds[i].keysym);
-		if (keycode) {
-			XGrabKey(dpy, keycode, keybinds[i].mod, root, True, GrabModeAsync, GrabModeAsync);
-			log_message(stdout, LOG_DEBUG, "Grabbed key: mod=0x%x, keysym=0x%lx", keybinds[i].mod, keybinds[i].keysym);
-		}
-	}
-
-	// Grab keys for shortcuts.
-	for (unsigned int i = 0; i < LENGTH(shortcuts); i++) {
-		KeyCode keycode = XKeysymToKeycode(dpy, shortcuts[i].keysym);
-		if (keycode) {
-			XGrabKey(dpy, keycode, shortcuts[i].mod, root, True, GrabModeAsync, GrabModeAsync);
-			log_message(stdout, LOG_DEBUG, "Grabbed shortcut: mod=0x%x, keysym=0x%lx, command=%s", shortcuts[i].mod, shortcuts[i].keysym, shortcuts[i].cmd);
-		}
-	}
-
-	// Grab keys for window dragging (with MODKEY).
-	XGrabButton(dpy, 1, MODKEY, root, True, ButtonPressMask|ButtonReleaseMask|PointerMotionMask, GrabModeAsync, GrabModeAsync, None, None);
-	XGrabButton(dpy, 3, MODKEY, root, True, ButtonPressMask|ButtonReleaseMask|PointerMotionMask, GrabModeAsync, GrabModeAsync, None, None);
+	// All atoms are interned in a single round-trip.
+	char *atom_names[] = {
+		"WM_STATE",
+		"_NET_WM_DESKTOP",
+		"_NET_CURRENT_DESKTOP",
+		"_NET_NUMBER_OF_DESKTOPS",
+		"_NET_CLIENT_LIST",
+		"_NET_WM_STATE",
+		"_NET_WM_STATE_FULLSCREEN",
+		"_NET_ACTIVE_WINDOW",
+	};
+	Atom atoms[LENGTH(atom_names)];
+	XInternAtoms(dpy, atom_names, LENGTH(atom_names), False, atoms);
+	WM_STATE = atoms[0];
+	_NET_WM_DESKTOP = atoms[1];
+	_NET_CURRENT_DESKTOP = atoms[2];
+	_NET_NUMBER_OF_DESKTOPS = atoms[3];
+	_NET_CLIENT_LIST = atoms[4];
+	_NET_WM_STATE = atoms[5];
+	_NET_WM_STATE_FULLSCREEN = atoms[6];
+	_NET_ACTIVE_WINDOW = atoms[7];
+
+	client_init(root, _NET_CLIENT_LIST);
+	layout_init(default_layout, master_size);
+	spatial_init(snap_distance);
+	cycle_init();
+
+	// Grab keys for keybinds and shortcuts, and the buttons for window
+	// dragging (with MODKEY).
+	keys_init(root, keybinds, LENGTH(keybinds), shortcuts, LENGTH(shortcuts), key_repeat_acceleration, MODKEY);
 
 	// Prepare border colors.
 	Colormap cmap = DefaultColormap(dpy, screen);
@@ -575,284 +957,132 @@ int main(void) {
 
 	// Root window input selection masks.
 	XSelectInput(dpy, root,
-			SubstructureRedirectMask | SubstructureNotifyMask |
+			SubstructureRedirectMask | SubstructureNotifyMask | StructureNotifyMask |
 			FocusChangeMask | EnterWindowMask | LeaveWindowMask |
-			ButtonPressMask | ExposureMask);
-
-	start.subwindow = None;
-
-	// Starts Expose ticker for updating widgets.
-	pthread_t timer_tid;
-	if (pthread_create(&timer_tid, NULL, expose_timer_thread, NULL) != 0) {
-		fprintf(stderr, "failed to create timer thread\n");
-	} else {
-		pthread_detach(timer_tid);
-	}
-
-	for(;;) {
-		XNextEvent(dpy, &ev);
-
-		switch (ev.type) {
-			case MapRequest:
-				{
-					Window window = ev.xmaprequest.window;
-					XSetWindowBorderWidth(dpy, window, border_size);
-					XSetWindowBorder(dpy, window, inactive_border);
-
-					XWindowAttributes check_attr;
-					if (XGetWindowAttributes(dpy, window, &check_attr)) {
-						XSelectInput(dpy, window, EnterWindowMask | LeaveWindowMask);
-
-						Window root_return, child_return;
-						int root_x, root_y, win_x, win_y;
-						unsigned int mask;
+			ButtonPressMask);
 
-						if (XQueryPointer(dpy, root, &root_return, &child_return, &root_x, &root_y, &win_x, &win_y, &mask)) {
-							int new_x = root_x - (check_attr.width / 2);
-							int new_y = root_y - (check_attr.height / 2);
-							int screen_width = DisplayWidth(dpy, screen);
-							int screen_height = DisplayHeight(dpy, screen);
-
-							if (new_x < 0) new_x = 0;
-							if (new_y < 0) new_y = 0;
-							if (new_x + check_attr.width > screen_width) new_x = screen_width - check_attr.width;
-							if (new_y + check_attr.height > screen_height) new_y = screen_height - check_attr.height;
-
-							XMoveWindow(dpy, window, new_x, new_y);
-							log_message(stdout, LOG_DEBUG, "Positioned new window 0x%lx at cursor (%d, %d)", window, root_x, root_y);
-						}
-					}
-
-					XMapWindow(dpy, window);
-					log_message(stdout, LOG_DEBUG, "Window 0x%lx mapped", window);
-
-					// Make the new window active and focused.
-					XRaiseWindow(dpy, window);
-					XSetInputFocus(dpy, window, RevertToPointerRoot, CurrentTime);
-					update_borders(window);
-					log_message(stdout, LOG_DEBUG, "Window 0x%lx raised and focused", window);
+	// Existing windows are adopted after the redirect is in place, so a
+	// window mapped in between arrives as a MapRequest instead of slipping
+	// through unmanaged.
+	adopt_windows();
 
+	// Set number of desktops and current desktop. Clients such as the
+	// benchmark take these as the sign that the WM manages new windows, so
+	// they are only published once the redirect is selected.
+	XChangeProperty(dpy, root, _NET_NUMBER_OF_DESKTOPS, XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&number_of_desktops, 1);
+	XChangeProperty(dpy, root, _NET_CURRENT_DESKTOP, XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&current_desktop, 1);
 
-					add_to_client_list(window);
-					set_window_desktop(window, current_desktop);
+	start.subwindow = None;
 
-					// Update border color based on desktop (sticky windows get violet border).
-					unsigned long border_color;
-					if (get_window_desktop(window) == 0) {
-						border_color = sticky_active_border;
-					} else {
-						border_color = active_border;
-					}
-					XSetWindowBorder(dpy, window, border_color);
-				} break;
-
-			case DestroyNotify:
-				{
-					if (ev.xdestroywindow.window == active_window) {
-						update_borders(None);
-						log_message(stdout, LOG_DEBUG, "Window 0x%lx destroyed", ev.xdestroywindow.window);
-					}
+	if (replay_path) {
+		int status = journal_replay(replay_path, replay_event);
+		bar_cleanup();
+		XCloseDisplay(dpy);
+		return status;
+	}
 
-					if (ev.xdestroywindow.window == fullscreen_window) {
-						fullscreen_window = None;
-						log_message(stdout, LOG_DEBUG, "Fullscreen window 0x%lx destroyed", ev.xdestroywindow.window);
-					}
+	journal_open();
 
-					// Remove from vertical maximize tracking.
-					// TODO: Convert this to linked list.
-					for (int i = 0; i < vmaximize_count; i++) {
-						if (vmaximize_windows[i].window == ev.xdestroywindow.window) {
-							// Shift remaining elements left.
-							for (int j = i; j < vmaximize_count - 1; j++) {
-								vmaximize_windows[j] = vmaximize_windows[j + 1];
-							}
-							vmaximize_count--;
-							log_message(stdout, LOG_DEBUG, "Vertically maximized window 0x%lx destroyed", ev.xdestroywindow.window);
-							break;
-						}
-					}
+	// Timers and signals are delivered through file descriptors, so they are
+	// handled inline by the same thread that owns the X connection.
+	int timer_fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer_fd == -1) {
+		log_message(stderr, LOG_ERROR, "Failed to create timerfd");
+		widgets_update(time(NULL));
+	} else {
+		schedule_widgets(timer_fd);
+	}
 
-					// Remove from horizontal maximize tracking.
-					// TODO: Convert this to linked list.
-					for (int i = 0; i < hmaximize_count; i++) {
-						if (hmaximize_windows[i].window == ev.xdestroywindow.window) {
-							// Shift remaining elements left.
-							for (int j = i; j < hmaximize_count - 1; j++) {
-								hmaximize_windows[j] = hmaximize_windows[j + 1];
-							}
-							hmaximize_count--;
-							log_message(stdout, LOG_DEBUG, "Horizontally maximized window 0x%lx destroyed", ev.xdestroywindow.window);
-							break;
-						}
-					}
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigaddset(&signals, SIGHUP);
+	sigaddset(&signals, SIGCHLD);
+	sigaddset(&signals, SIGUSR1);
+	sigprocmask(SIG_BLOCK, &signals, NULL);
+	int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (signal_fd == -1) {
+		log_message(stderr, LOG_ERROR, "Failed to create signalfd");
+		// Let the kernel reap children so they don't pile up as zombies.
+		signal(SIGCHLD, SIG_IGN);
+	}
 
-					remove_from_client_list(ev.xdestroywindow.window);
-				} break;
+	ipc_init();
+
+	// The first three slots are fixed, the control socket and its
+	// connections follow and are refreshed on every iteration.
+	struct pollfd fds[3 + IPC_MAX_FDS] = {
+		{ .fd = ConnectionNumber(dpy), .events = POLLIN },
+		{ .fd = timer_fd, .events = POLLIN },
+		{ .fd = signal_fd, .events = POLLIN },
+	};
+
+	bool running = true;
+	while (running) {
+		// XPending flushes the output buffer and reads whatever the server
+		// has sent, so nothing is left behind before blocking in poll.
+		while (XPending(dpy)) {
+			event_next(&ev);
+			dispatch_event();
+		}
 
-			case UnmapNotify:
-				{
-					log_message(stdout, LOG_DEBUG, "Window 0x%lx unmapped", ev.xunmap.window);
-				} break;
+		// Log and journal records are written out while the WM is idle.
+		log_flush();
+		journal_flush();
 
-			case FocusIn:
-				{
-					if (ev.xfocus.window != root) {
-						update_borders(ev.xfocus.window);
-					}
-				}
-				break;
+		int ipc_count = ipc_poll_fds(&fds[3]);
+		if (poll(fds, 3 + ipc_count, drag_flush_timeout()) == -1) {
+			if (errno == EINTR) continue;
+			log_message(stderr, LOG_ERROR, "poll failed: %s", strerror(errno));
+			break;
+		}
 
-			case FocusOut:
-				{
-					if (ev.xfocus.window == active_window) {
-						update_borders(None);
-					}
-				} break;
-
-			case EnterNotify:
-				{
-					if (follow_focus) {
-						Window entered_window = ev.xcrossing.window;
-						if (entered_window != root && ev.xcrossing.mode == NotifyNormal) {
-							if (entered_window != None && entered_window != active_window) {
-								XRaiseWindow(dpy, entered_window);
-								XSetInputFocus(dpy, entered_window, RevertToPointerRoot, CurrentTime);
-								update_borders(entered_window);
-							}
-						}
-					}
-				} break;
+		drag_flush();
 
-			case KeyPress:
-				{
-					KeySym keysym = XkbKeycodeToKeysym(dpy, ev.xkey.keycode, 0, 0);
+		// Commands from the control socket; their requests are flushed
+		// together by XPending at the top of the loop.
+		ipc_handle(&fds[3], ipc_count);
 
-					// Check keybinds first.
-					for (unsigned int i = 0; i < LENGTH(keybinds); i++) {
-						if (keysym == keybinds[i].keysym && (ev.xkey.state & (Mod1Mask|Mod2Mask|Mod3Mask|Mod4Mask|ControlMask|ShiftMask)) == keybinds[i].mod) {
-							keybinds[i].func(&keybinds[i].arg);
-							break;
-						}
-					}
+		if (fds[1].revents & POLLIN) {
+			uint64_t expirations;
+			ssize_t received = read(timer_fd, &expirations, sizeof(expirations));
+			if (received == sizeof(expirations) || (received == -1 && errno == ECANCELED)) {
+				schedule_widgets(timer_fd);
+			}
+		}
 
-					// Check shortcuts.
-					for (unsigned int i = 0; i < LENGTH(shortcuts); i++) {
-						if (keysym == shortcuts[i].keysym && (ev.xkey.state & (Mod1Mask|Mod2Mask|Mod3Mask|Mod4Mask|ControlMask|ShiftMask)) == shortcuts[i].mod) {
-							execute_shortcut(shortcuts[i].cmd);
-							break;
-						}
-					}
-				} break;
-
-			case ButtonPress:
-				{
-					if (ev.xbutton.subwindow != None) {
-						if (ev.xbutton.state & MODKEY) {
-							XGetWindowAttributes(dpy, ev.xbutton.subwindow, &attr);
-							start = ev.xbutton;
-
-							// Raise and focus the window.
-							XRaiseWindow(dpy, ev.xbutton.subwindow);
-							XSetInputFocus(dpy, ev.xbutton.subwindow, RevertToPointerRoot, CurrentTime);
-							update_borders(ev.xbutton.subwindow);
-
-							// Set appropriate cursor for dragging.
-							if (start.button == 1) {
-								log_message(stdout, LOG_DEBUG, "Setting cursor to move");
-								XDefineCursor(dpy, start.subwindow, cursor_move);
-							} else if (start.button == 3) {
-								log_message(stdout, LOG_DEBUG, "Setting cursor to resize");
-								XDefineCursor(dpy, start.subwindow, cursor_resize);
-							}
-							log_message(stdout, LOG_DEBUG, "MODKEY click on window 0x%lx - dragging enabled", ev.xbutton.subwindow);
-						}
-						XFlush(dpy);
-					}
-				} break;
-
-			case ButtonRelease:
-				{
-					if (start.subwindow != None) {
-						// MODKEY drag release: restore cursor.
-						if (start.state & MODKEY) {
-							XDefineCursor(dpy, start.subwindow, None);
-						}
-						XFlush(dpy);
-					}
-				} break;
-
-			case MotionNotify:
-				{
-					if (start.subwindow != None && (start.state & MODKEY)) {
-						int xdiff = ev.xmotion.x_root - start.x_root;
-						int ydiff = ev.xmotion.y_root - start.y_root;
-
-						XMoveResizeWindow(dpy, start.subwindow,
-								attr.x + (start.button == 1 ? xdiff : 0),
-								attr.y + (start.button == 1 ? ydiff : 0),
-								MAX(50, attr.width  + (start.button == 3 ? xdiff : 0)),
-								MAX(50, attr.height + (start.button == 3 ? ydiff : 0)));
-					}
-				} break;
-
-			case ClientMessage:
-				{
-					if (ev.xclient.message_type == _NET_WM_STATE) {
-						Atom action = ev.xclient.data.l[0];
-						Atom state = ev.xclient.data.l[1];
-						Window window = ev.xclient.window;
-
-						if (state == _NET_WM_STATE_FULLSCREEN) {
-							if (action == 1) { // _NET_WM_STATE_ADD
-								set_fullscreen(window, 1);
-							} else if (action == 0) { // _NET_WM_STATE_REMOVE
-								set_fullscreen(window, 0);
-							} else if (action == 2) { // _NET_WM_STATE_TOGGLE
-								toggle_fullscreen(window);
-							}
-						}
-					} else if (ev.xclient.message_type == _NET_ACTIVE_WINDOW) {
-						Window window = ev.xclient.data.l[0];
-						if (window != None && window_exists(window)) {
-							// Check if window is on current desktop.
-							unsigned long window_desktop = get_window_desktop(window);
-							if (window_desktop == current_desktop) {
-								XRaiseWindow(dpy, window);
-								XSetInputFocus(dpy, window, RevertToPointerRoot, CurrentTime);
-								update_borders(window);
-								log_message(stdout, LOG_DEBUG, "Activated window 0x%lx via _NET_ACTIVE_WINDOW", window);
-							} else {
-								// Switch to the window's desktop first.
-								switch_desktop(window_desktop);
-								XRaiseWindow(dpy, window);
-								XSetInputFocus(dpy, window, RevertToPointerRoot, CurrentTime);
-								update_borders(window);
-								log_message(stdout, LOG_DEBUG, "Activated window 0x%lx on desktop %lu via _NET_ACTIVE_WINDOW", window, window_desktop);
-							}
-						}
-					}
+		if (fds[2].revents & POLLIN) {
+			struct signalfd_siginfo info;
+			while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+				if (info.ssi_signo == SIGCHLD) {
+					reap_processes();
+					continue;
 				}
-				break;
-
-			case Expose:
-				if (ev.xexpose.window == root) {
-					draw_desktop_number();
-					draw_current_time();
+				if (info.ssi_signo == SIGUSR1) {
+					stats_dump();
+#ifdef PROFILE
+					profile_report();
+#endif
+					continue;
 				}
-				break;
-
-			default:
-				break;
+				log_message(stdout, LOG_INFO, "Received signal %u, exiting", info.ssi_signo);
+				running = false;
+			}
 		}
 	}
 
+	if (timer_fd != -1) close(timer_fd);
+	if (signal_fd != -1) close(signal_fd);
+	journal_close();
+	ipc_cleanup();
+
+	XFreeGC(dpy, outline_gc);
 	XFreeCursor(dpy, cursor_default);
 	XFreeCursor(dpy, cursor_move);
 	XFreeCursor(dpy, cursor_resize);
 
-	XftColorFree(dpy, visual, colormap, &xft_color);
-	if (xft_font) XftFontClose(dpy, xft_font);
-	XftDrawDestroy(xft_draw);
+	bar_cleanup();
 	XFlush(dpy);
 
 	return 0;
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <X11/Xlib.h>
+
+#ifdef USE_XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif
+
+#include "plusminus.h"
+
+// Monitor geometry. The rectangles of the active outputs are cached in a
+// table with the primary output first, so placement code looks a monitor up
+// without asking the server. The table is only rebuilt when the server
+// reports a change: RRScreenChangeNotify in builds with XRANDR=1, otherwise a
+// resize of the root window, in which case the whole screen is one monitor.
+
+#define MONITOR_MAX 16
+
+static Geometry monitors[MONITOR_MAX];
+static int monitor_total = 0;
+static Window root;
+
+#ifdef USE_XRANDR
+static int randr_event_base = -1;
+#endif
+
+static void use_whole_screen(void) {
+	int screen = DefaultScreen(dpy);
+	monitors[0] = (Geometry){ 0, 0, DisplayWidth(dpy, screen), DisplayHeight(dpy, screen) };
+	monitor_total = 1;
+}
+
+static void refresh(void) {
+#ifdef USE_XRANDR
+	if (randr_event_base != -1) {
+		int count = 0;
+		XRRMonitorInfo *info = XRRGetMonitors(dpy, root, True, &count);
+
+		monitor_total = 0;
+		for (int i = 0; i < count && monitor_total < MONITOR_MAX; i++) {
+			Geometry g = { info[i].x, info[i].y, info[i].width, info[i].height };
+			if (g.width <= 0 || g.height <= 0) continue;
+
+			// The primary output goes first, the rest keep server order.
+			if (info[i].primary && monitor_total > 0) {
+				monitors[monitor_total++] = monitors[0];
+				monitors[0] = g;
+			} else {
+				monitors[monitor_total++] = g;
+			}
+		}
+		if (info) XRRFreeMonitors(info);
+	}
+#endif
+
+	if (monitor_total == 0) use_whole_screen();
+
+	for (int i = 0; i < monitor_total; i++) {
+		log_message(stdout, LOG_DEBUG, "Monitor %d: %dx%d at (%d,%d)", i, monitors[i].width, monitors[i].height, monitors[i].x, monitors[i].y);
+	}
+}
+
+void monitor_init(Window root_window) {
+	root = root_window;
+
+#ifdef USE_XRANDR
+	int error_base;
+	int major = 0, minor = 0;
+	if (XRRQueryExtension(dpy, &randr_event_base, &error_base) && XRRQueryVersion(dpy, &major, &minor) && (major > 1 || minor >= 5)) {
+		XRRSelectInput(dpy, root, RRScreenChangeNotifyMask);
+	} else {
+		log_message(stderr, LOG_WARNING, "RandR 1.5 is not available, treating the screen as one monitor");
+		randr_event_base = -1;
+	}
+#endif
+
+	refresh();
+}
+
+// Returns true when the event changed the monitor table.
+bool monitor_update(const XEvent *e) {
+#ifdef USE_XRANDR
+	if (randr_event_base != -1) {
+		if (e->type != randr_event_base + RRScreenChangeNotify) return false;
+		// Keeps DisplayWidth and DisplayHeight in step with the new size.
+		XRRUpdateConfiguration((XEvent *)e);
+		refresh();
+		return true;
+	}
+#endif
+
+	if (e->type != ConfigureNotify || e->xconfigure.window != root) return false;
+
+	if (monitors[0].width == e->xconfigure.width && monitors[0].height == e->xconfigure.height) return false;
+
+	// Xlib only updates the screen size from RandR events, so the fallback
+	// takes it from the root window instead.
+	monitors[0] = (Geometry){ 0, 0, e->xconfigure.width, e->xconfigure.height };
+	monitor_total = 1;
+	log_message(stdout, LOG_DEBUG, "Screen resized to %dx%d", e->xconfigure.width, e->xconfigure.height);
+	return true;
+}
+
+const Geometry *monitor_primary(void) {
+	return &monitors[0];
+}
+
+// The monitor containing the point, or the closest one when the point lies in
+// a gap between outputs or off-screen.
+const Geometry *monitor_at(int x, int y) {
+	const Geometry *best = &monitors[0];
+	long best_distance = -1;
+
+	for (int i = 0; i < monitor_total; i++) {
+		const Geometry *m = &monitors[i];
+		long dx = x < m->x ? m->x - x : (x >= m->x + m->width ? x - (m->x + m->width - 1) : 0);
+		long dy = y < m->y ? m->y - y : (y >= m->y + m->height ? y - (m->y + m->height - 1) : 0);
+		long distance = dx * dx + dy * dy;
+
+		if (distance == 0) return m;
+		if (best_distance == -1 || distance < best_distance) {
+			best = m;
+			best_distance = distance;
+		}
+	}
+	return best;
+}
+
+// The monitor holding the centre of the client's outer rectangle.
+const Geometry *monitor_for_client(const Client *c) {
+	return monitor_at(c->x + c->width / 2 + c->border_width, c->y + c->height / 2 + c->border_width);
+}
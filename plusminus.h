@@ -1,6 +1,9 @@
 #ifndef PLUSMINUS_H
 #define PLUSMINUS_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
 #include <X11/Xlib.h>
 
 #define MAX(a, b) ((a) > (b) ? (a) : (b))
@@ -30,6 +33,65 @@ typedef struct {
 	const char *cmd;
 } Shortcut;
 
+typedef struct {
+	bool (*func)(char *text, size_t size);
+	unsigned int interval;  // Seconds between refreshes, 0 picks a default.
+} Widget;
+
+typedef enum {
+	SWITCH_UNMAP,
+	SWITCH_PARK,
+} SwitchMode;
+
+typedef enum {
+	LAYOUT_FLOATING,
+	LAYOUT_MASTER_STACK,
+	LAYOUT_GRID,
+} Layout;
+
+typedef enum {
+	DIRECTION_LEFT,
+	DIRECTION_RIGHT,
+	DIRECTION_UP,
+	DIRECTION_DOWN,
+} Direction;
+
+// X position of windows parked off-screen by SWITCH_PARK.
+#define PARKED_X (-32000)
+
+typedef struct {
+	int x, y, width, height;
+} Geometry;
+
+typedef struct Client Client;
+struct Client {
+	Window window;
+	unsigned long desktop;
+	bool sticky;
+	bool mapped;
+	bool parked;           // Kept mapped but moved off-screen (SWITCH_PARK).
+	bool alive;            // Cleared when the server reports BadWindow.
+	int x, y, width, height, border_width;
+	unsigned long configure_serial;  // Serial of the last configure we sent.
+	bool fullscreen, vmaximized, hmaximized;
+	Geometry fullscreen_saved;       // Geometry to restore for each mode.
+	Geometry vmaximize_saved;
+	Geometry hmaximize_saved;
+	Client *next, *prev;   // Mapping order, used for _NET_CLIENT_LIST.
+	Client *desktop_next, *desktop_prev;  // Membership of one desktop list.
+	Client *hash_next;     // Hash bucket chain.
+	Client *mru_next, *mru_prev;  // Focus order, most recently used first.
+	int tile;              // 1-based slot in its desktop's tile order, 0 if none.
+};
+
+// Replies needed to place a newly mapped window.
+typedef struct {
+	bool valid;
+	int x, y, width, height;
+	bool pointer_valid;
+	int pointer_x, pointer_y;
+} MapInfo;
+
 typedef enum {
 	LOG_INFO,
 	LOG_DEBUG,
@@ -39,7 +101,19 @@ typedef enum {
 
 void set_log_level(LogLevel level);
 LogLevel get_log_level_from_env(void);
-void log_message(FILE *stream, LogLevel level, const char* format, ...);
+void log_write(FILE *stream, LogLevel level, const char* format, ...);
+void log_flush(void);
+
+// Builds with LOG_NO_DEBUG (make RELEASE=1) compile DEBUG messages out
+// entirely, arguments included.
+#ifdef LOG_NO_DEBUG
+#define LOG_COMPILED(level) ((level) != LOG_DEBUG)
+#else
+#define LOG_COMPILED(level) 1
+#endif
+
+#define log_message(stream, level, ...) \
+	do { if (LOG_COMPILED(level)) log_write(stream, level, __VA_ARGS__); } while (0)
 
 // External variables.
 extern Display *dpy;
@@ -51,30 +125,124 @@ extern unsigned long inactive_border;
 extern unsigned long sticky_active_border;
 extern unsigned long sticky_inactive_border;
 
-// Maximize state tracking.
-#define MAX_MAXIMIZE_WINDOWS 32
-
-typedef struct {
-	Window window;
-	int x, y, width, height;
-} MaximizeState;
-
-extern MaximizeState vmaximize_windows[MAX_MAXIMIZE_WINDOWS];
-extern int vmaximize_count;
-extern MaximizeState hmaximize_windows[MAX_MAXIMIZE_WINDOWS];
-extern int hmaximize_count;
-
 // External functions.
 int window_exists(Window w);
 unsigned long get_window_desktop(Window w);
 void set_window_desktop(Window window, unsigned long desktop);
+void move_window_to_desktop(Window window, unsigned long desktop);
+void activate_window(Window window);
 void switch_desktop(unsigned long desktop);
+void hide_client(Client *c);
+void toggle_fullscreen(Window window);
+void show_client(Client *c);
 void update_borders(Window new_active);
-void add_to_client_list(Window window);
-void remove_from_client_list(Window window);
 void draw_desktop_number(void);
-void draw_current_time(void);
+long long monotonic_ns(void);
 void execute_shortcut(const char *command);
+void reap_processes(void);
+
+// Client registry.
+void client_init(Window root_window, Atom client_list_atom);
+Client *client_find(Window window);
+Client *client_add(Window window);
+void client_remove(Window window);
+Client *client_first(void);
+unsigned long client_total(void);
+void client_publish_list(void);
+void client_set_desktop(Client *c, unsigned long desktop);
+Client *client_desktop_first(unsigned long desktop);
+void client_mru_touch(Client *c);
+Client *client_mru_first(void);
+void client_set_geometry(Client *c, int x, int y, int width, int height, int border_width);
+void client_configure_notify(const XConfigureEvent *e);
+void client_move(Client *c, int x, int y);
+void client_resize(Client *c, int width, int height);
+void client_move_resize(Client *c, int x, int y, int width, int height);
+void client_set_border_width(Client *c, int border_width);
+
+// Tiling layouts.
+void layout_init(Layout default_layout, int master_size);
+Layout layout_get(unsigned long desktop);
+void layout_set(unsigned long desktop, Layout layout);
+void layout_arrange(unsigned long desktop);
+
+// MRU window and desktop cycling.
+void cycle_init(void);
+bool cycle_active(void);
+void cycle_desktop_visited(unsigned long desktop);
+bool cycle_key_press(const XKeyEvent *e);
+void cycle_key_release(const XKeyEvent *e);
+
+// Monitor geometry.
+void monitor_init(Window root_window);
+bool monitor_update(const XEvent *e);
+const Geometry *monitor_primary(void);
+const Geometry *monitor_at(int x, int y);
+const Geometry *monitor_for_client(const Client *c);
+
+// Spatial index of visible windows.
+void spatial_init(int distance);
+void spatial_invalidate(const Client *c);
+void spatial_pin(Window window);
+int spatial_snap_x(int x, int y, int width, int height);
+int spatial_snap_y(int x, int y, int width, int height);
+int spatial_edge_x(const Geometry *monitor, int x, int y, int height, bool forward);
+int spatial_edge_y(const Geometry *monitor, int y, int x, int width, bool forward);
+Client *spatial_neighbour(const Client *from, Direction direction);
+
+// Key dispatch.
+void keys_init(Window root_window, const Keybinds *kb, size_t kb_count, const Shortcut *sc, size_t sc_count, bool repeat_acceleration, unsigned int drag_modifier);
+void keys_grab(void);
+void keys_dispatch(const XKeyEvent *e);
+void keys_release(const XKeyEvent *e);
+unsigned int keys_dispatch_state(void);
+
+// Status bar.
+void bar_init(Window root_window, const char *font_name);
+void bar_place(const Geometry *monitor);
+Window bar_window(void);
+int bar_add_segment(bool highlight);
+void bar_set_segment(int index, const char *text);
+void bar_render(void);
+void bar_expose(const XExposeEvent *e);
+void bar_cleanup(void);
+
+// Status bar widgets.
+void widgets_init(const Widget *widgets, size_t count, const char *time_format);
+void widgets_update(time_t now);
+time_t widgets_next_wakeup(void);
+bool widget_time(char *text, size_t size);
+bool widget_cpu(char *text, size_t size);
+bool widget_memory(char *text, size_t size);
+
+// Event handler latency statistics.
+void stats_record(int type, long long ns);
+void stats_dump(void);
+const char *stats_event_name(int type);
+
+// Event journal.
+void journal_open(void);
+int event_queued(void);
+void event_peek(XEvent *e);
+void event_next(XEvent *e);
+void event_put_back(XEvent *e);
+void journal_flush(void);
+void journal_close(void);
+int journal_replay(const char *path, void (*dispatch)(const XEvent *e));
+bool journal_replaying(void);
+
+// Control socket.
+#define IPC_MAX_FDS 17
+
+struct pollfd;
+void ipc_init(void);
+int ipc_poll_fds(struct pollfd *fds);
+void ipc_handle(const struct pollfd *fds, int count);
+void ipc_notify(const char *format, ...);
+void ipc_cleanup(void);
+
+// Batched server queries.
+bool fetch_map_info(Window root, Window window, MapInfo *info);
 
 // Function implementations.
 void move_window_x(const Arg *arg);
@@ -92,11 +260,44 @@ void window_snap_down(const Arg *arg);
 void window_snap_right(const Arg *arg);
 void window_snap_left(const Arg *arg);
 void sticky(const Arg *arg);
+void set_layout(const Arg *arg);
+void focus_direction(const Arg *arg);
+void cycle_windows(const Arg *arg);
+void cycle_desktops(const Arg *arg);
+
+// Round-trip profiler (make PROFILE=1). Every call below blocks until the
+// server replies; the wrappers record how long it took and where it came from.
+#ifdef PROFILE
+void profile_enter(int event_type);
+void profile_leave(void);
+void profile_begin(void);
+void profile_end(const char *call, const char *caller);
+int profile_end_int(const char *call, const char *caller, int result);
+unsigned long profile_end_ulong(const char *call, const char *caller, unsigned long result);
+void *profile_end_pointer(const char *call, const char *caller, void *result);
+void profile_report(void);
 
-// Helper functions for maximize state management.
-int find_vmaximize_window(Window window);
-int find_hmaximize_window(Window window);
-void remove_vmaximize_window(Window window);
-void remove_hmaximize_window(Window window);
+#define XGetWindowAttributes(d, w, attr) \
+	(profile_begin(), profile_end_int("XGetWindowAttributes", __func__, XGetWindowAttributes(d, w, attr)))
+#define XGetGeometry(d, w, root, x, y, width, height, border, depth) \
+	(profile_begin(), profile_end_int("XGetGeometry", __func__, XGetGeometry(d, w, root, x, y, width, height, border, depth)))
+#define XGetWindowProperty(d, w, prop, offset, length, del, req, type, format, items, after, data) \
+	(profile_begin(), profile_end_int("XGetWindowProperty", __func__, XGetWindowProperty(d, w, prop, offset, length, del, req, type, format, items, after, data)))
+#define XQueryPointer(d, w, root, child, root_x, root_y, win_x, win_y, mask) \
+	(profile_begin(), profile_end_int("XQueryPointer", __func__, XQueryPointer(d, w, root, child, root_x, root_y, win_x, win_y, mask)))
+#define XQueryTree(d, w, root, parent, children, count) \
+	(profile_begin(), profile_end_int("XQueryTree", __func__, XQueryTree(d, w, root, parent, children, count)))
+#define XSync(d, discard) \
+	(profile_begin(), profile_end_int("XSync", __func__, XSync(d, discard)))
+#define XInternAtom(d, name, only_if_exists) \
+	(profile_begin(), (Atom)profile_end_ulong("XInternAtom", __func__, XInternAtom(d, name, only_if_exists)))
+#define XInternAtoms(d, names, count, only_if_exists, atoms) \
+	(profile_begin(), profile_end_int("XInternAtoms", __func__, XInternAtoms(d, names, count, only_if_exists, atoms)))
+#define XGetModifierMapping(d) \
+	(profile_begin(), (XModifierKeymap *)profile_end_pointer("XGetModifierMapping", __func__, XGetModifierMapping(d)))
+#else
+#define profile_enter(event_type) ((void)0)
+#define profile_leave() ((void)0)
+#endif
 
 #endif // PLUSMINUS_H.
@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "plusminus.h"
+
+// Launching shell commands. Children are started with posix_spawn, which does
+// not copy the WM's page tables the way fork() does, and are reaped from the
+// event loop when SIGCHLD arrives through the signalfd. Every running child
+// is tracked with its command and start time so its exit can be reported.
+
+typedef struct {
+	pid_t pid;
+	const char *command;
+	long long started;
+} Process;
+
+extern char **environ;
+
+static Process *processes = NULL;
+static size_t process_count = 0;
+static size_t process_capacity = 0;
+
+static void track_process(pid_t pid, const char *command) {
+	if (process_count == process_capacity) {
+		size_t capacity = process_capacity ? process_capacity * 2 : 16;
+		Process *grown = realloc(processes, capacity * sizeof(Process));
+		if (!grown) {
+			log_message(stderr, LOG_WARNING, "Failed to track process %d (%s)", (int)pid, command);
+			return;
+		}
+		processes = grown;
+		process_capacity = capacity;
+	}
+
+	processes[process_count].pid = pid;
+	processes[process_count].command = command;
+	processes[process_count].started = monotonic_ns();
+	process_count++;
+}
+
+void execute_shortcut(const char *command) {
+	if (!command || strlen(command) == 0) {
+		log_message(stderr, LOG_WARNING, "Empty command provided to execute_shortcut");
+		return;
+	}
+
+	// Replayed shortcuts would start every recorded program again, and
+	// nothing reaps children on the replay path.
+	if (journal_replaying()) {
+		log_message(stdout, LOG_DEBUG, "Not running %s during replay", command);
+		return;
+	}
+
+	// Signals handled through signalfd are blocked in the WM, the child
+	// starts with an empty mask.
+	posix_spawnattr_t attr;
+	sigset_t none;
+	sigemptyset(&none);
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setsigmask(&attr, &none);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+	pid_t pid;
+	char *argv[] = { "sh", "-c", (char *)command, NULL };
+	int err = posix_spawn(&pid, "/bin/sh", NULL, &attr, argv, environ);
+	posix_spawnattr_destroy(&attr);
+
+	if (err != 0) {
+		log_message(stderr, LOG_ERROR, "Failed to execute command: %s (%s)", command, strerror(err));
+		return;
+	}
+
+	track_process(pid, command);
+	log_message(stdout, LOG_DEBUG, "Executed command in background: %s (pid %d)", command, (int)pid);
+}
+
+void reap_processes(void) {
+	int status;
+	pid_t pid;
+
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+		const char *command = "unknown";
+		double runtime = 0;
+
+		for (size_t i = 0; i < process_count; i++) {
+			if (processes[i].pid == pid) {
+				command = processes[i].command;
+				runtime = (monotonic_ns() - processes[i].started) / 1e9;
+				processes[i] = processes[--process_count];
+				break;
+			}
+		}
+
+		if (WIFEXITED(status)) {
+			log_message(stdout, LOG_DEBUG, "Command exited with status %d after %.2fs: %s (pid %d)", WEXITSTATUS(status), runtime, command, (int)pid);
+		} else if (WIFSIGNALED(status)) {
+			log_message(stdout, LOG_DEBUG, "Command killed by signal %d after %.2fs: %s (pid %d)", WTERMSIG(status), runtime, command, (int)pid);
+		}
+	}
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "plusminus.h"
+
+// Round-trip accounting, built with make PROFILE=1. The synchronous Xlib calls
+// are wrapped by macros in plusminus.h that time each call and record it under
+// the call name, the function it was made from and the event handler that was
+// running at the time. The report lists where the WM blocked on the server,
+// most expensive first.
+
+#define PROFILE_MAX_SITES 256
+#define PROFILE_NO_HANDLER (-1)
+
+typedef struct {
+	const char *call;
+	const char *caller;
+	int handler;
+	unsigned long count;
+	long long blocked;
+} RoundTripSite;
+
+static RoundTripSite sites[PROFILE_MAX_SITES];
+static size_t site_count = 0;
+static bool sites_full = false;
+
+static int current_handler = PROFILE_NO_HANDLER;
+static long long call_started = 0;
+
+static RoundTripSite *find_site(const char *call, const char *caller) {
+	for (size_t i = 0; i < site_count; i++) {
+		RoundTripSite *site = &sites[i];
+		if (site->handler == current_handler && strcmp(site->call, call) == 0 && strcmp(site->caller, caller) == 0) {
+			return site;
+		}
+	}
+
+	if (site_count == PROFILE_MAX_SITES) {
+		if (!sites_full) log_message(stderr, LOG_WARNING, "Round-trip profiler is out of call sites");
+		sites_full = true;
+		return NULL;
+	}
+
+	RoundTripSite *site = &sites[site_count++];
+	site->call = call;
+	site->caller = caller;
+	site->handler = current_handler;
+	return site;
+}
+
+static const char *handler_name(int handler) {
+	return handler == PROFILE_NO_HANDLER ? "main loop" : stats_event_name(handler);
+}
+
+static int by_blocked_time(const void *a, const void *b) {
+	const RoundTripSite *x = a, *y = b;
+	if (x->blocked != y->blocked) return x->blocked < y->blocked ? 1 : -1;
+	return 0;
+}
+
+void profile_enter(int event_type) {
+	current_handler = event_type;
+}
+
+void profile_leave(void) {
+	current_handler = PROFILE_NO_HANDLER;
+}
+
+void profile_begin(void) {
+	call_started = monotonic_ns();
+}
+
+void profile_end(const char *call, const char *caller) {
+	long long blocked = monotonic_ns() - call_started;
+
+	RoundTripSite *site = find_site(call, caller);
+	if (!site) return;
+	site->count++;
+	site->blocked += blocked;
+}
+
+int profile_end_int(const char *call, const char *caller, int result) {
+	profile_end(call, caller);
+	return result;
+}
+
+unsigned long profile_end_ulong(const char *call, const char *caller, unsigned long result) {
+	profile_end(call, caller);
+	return result;
+}
+
+void *profile_end_pointer(const char *call, const char *caller, void *result) {
+	profile_end(call, caller);
+	return result;
+}
+
+void profile_report(void) {
+	if (site_count == 0) {
+		log_message(stdout, LOG_INFO, "Round trips: none recorded");
+		return;
+	}
+
+	RoundTripSite sorted[PROFILE_MAX_SITES];
+	memcpy(sorted, sites, site_count * sizeof(RoundTripSite));
+	qsort(sorted, site_count, sizeof(RoundTripSite), by_blocked_time);
+
+	unsigned long total_count = 0;
+	long long total_blocked = 0;
+
+	log_message(stdout, LOG_INFO, "%-22s %-24s %-18s %8s %12s", "call", "caller", "handler", "count", "blocked(us)");
+	for (size_t i = 0; i < site_count; i++) {
+		const RoundTripSite *site = &sorted[i];
+		log_message(stdout, LOG_INFO, "%-22s %-24s %-18s %8lu %12.1f",
+				site->call, site->caller, handler_name(site->handler),
+				site->count, site->blocked / 1000.0);
+		total_count += site->count;
+		total_blocked += site->blocked;
+	}
+	log_message(stdout, LOG_INFO, "Round trips: %lu, blocked %.1fms", total_count, total_blocked / 1000000.0);
+}
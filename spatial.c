@@ -0,0 +1,375 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xlib.h>
+
+#include "plusminus.h"
+
+// Spatial index over the windows visible on the current desktop. Window edges
+// are kept in two sorted arrays, one for vertical edges (x positions) and one
+// for horizontal edges (y positions), and window centres in two more, so edge
+// snapping and directional focus are binary searches followed by a short walk
+// instead of a scan over every client.
+//
+// A client whose geometry, desktop or visibility changes is queued, and the
+// next query takes its old entries out of the arrays and inserts the new ones
+// in place. Only a desktop switch, or more changes than the queue holds,
+// sorts the whole index again. The window being dragged is pinned: it is left
+// out of the index and its moves are not queued, so a drag touches the index
+// twice at most.
+
+#define SPATIAL_MAX_PENDING 32
+
+typedef struct {
+	int position;
+	int from, to; // Extent along the other axis.
+	Window window;
+} Edge;
+
+typedef struct {
+	int x, y;
+	Client *client;
+	Window window;
+} Centre;
+
+static Edge *vertical_edges = NULL;
+static Edge *horizontal_edges = NULL;
+static Centre *centres_by_x = NULL;
+static Centre *centres_by_y = NULL;
+static size_t edge_count = 0;
+static size_t centre_count = 0;
+static size_t capacity = 0;
+
+static bool dirty = true;
+static Window pending[SPATIAL_MAX_PENDING];
+static size_t pending_count = 0;
+static Window pinned = None;
+static int snap_distance = 0;
+
+void spatial_init(int distance) {
+	snap_distance = MAX(0, distance);
+}
+
+static void queue_update(Window window) {
+	if (dirty) return;
+
+	for (size_t i = 0; i < pending_count; i++) {
+		if (pending[i] == window) return;
+	}
+
+	if (pending_count == SPATIAL_MAX_PENDING) {
+		dirty = true;
+		pending_count = 0;
+		return;
+	}
+	pending[pending_count++] = window;
+}
+
+void spatial_invalidate(const Client *c) {
+	if (!c) {
+		dirty = true;
+		pending_count = 0;
+		return;
+	}
+
+	if (c->window == pinned) return;
+	queue_update(c->window);
+}
+
+void spatial_pin(Window window) {
+	if (pinned == window) return;
+
+	// The old pinned window goes back in with its final geometry.
+	if (pinned != None) queue_update(pinned);
+	pinned = window;
+	if (pinned != None) queue_update(pinned);
+}
+
+static bool is_visible(const Client *c) {
+	return c->alive && c->mapped && !c->parked && c->window != pinned;
+}
+
+static bool on_current_desktop(const Client *c) {
+	return c->sticky || c->desktop == current_desktop;
+}
+
+static int compare_edges(const void *a, const void *b) {
+	const Edge *x = a, *y = b;
+	return (x->position > y->position) - (x->position < y->position);
+}
+
+static int compare_centres_x(const void *a, const void *b) {
+	const Centre *p = a, *q = b;
+	return (p->x > q->x) - (p->x < q->x);
+}
+
+static int compare_centres_y(const void *a, const void *b) {
+	const Centre *p = a, *q = b;
+	return (p->y > q->y) - (p->y < q->y);
+}
+
+static bool reserve(size_t clients) {
+	if (clients <= capacity) return true;
+
+	size_t grown = MAX(clients, capacity * 2);
+	Edge *v = realloc(vertical_edges, 2 * grown * sizeof(Edge));
+	if (v) vertical_edges = v;
+	Edge *h = realloc(horizontal_edges, 2 * grown * sizeof(Edge));
+	if (h) horizontal_edges = h;
+	Centre *cx = realloc(centres_by_x, grown * sizeof(Centre));
+	if (cx) centres_by_x = cx;
+	Centre *cy = realloc(centres_by_y, grown * sizeof(Centre));
+	if (cy) centres_by_y = cy;
+
+	if (!v || !h || !cx || !cy) {
+		log_message(stderr, LOG_ERROR, "Failed to grow spatial index to %lu clients", (unsigned long)grown);
+		return false;
+	}
+	capacity = grown;
+	return true;
+}
+
+// Index of the first edge at or after `position`.
+static size_t lower_bound(const Edge *edges, size_t count, int position) {
+	size_t low = 0, high = count;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if (edges[mid].position < position) low = mid + 1;
+		else high = mid;
+	}
+	return low;
+}
+
+static void insert_edge(Edge *edges, size_t count, Edge edge) {
+	size_t i = lower_bound(edges, count, edge.position);
+	memmove(&edges[i + 1], &edges[i], (count - i) * sizeof(Edge));
+	edges[i] = edge;
+}
+
+static void insert_centre(Centre *centres, Centre centre, bool by_x) {
+	int value = by_x ? centre.x : centre.y;
+	size_t low = 0, high = centre_count;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		if ((by_x ? centres[mid].x : centres[mid].y) < value) low = mid + 1;
+		else high = mid;
+	}
+	memmove(&centres[low + 1], &centres[low], (centre_count - low) * sizeof(Centre));
+	centres[low] = centre;
+}
+
+// Appends a client's entries, or inserts them in order when `sorted` is set.
+static void add_client(Client *c, bool sorted) {
+	int x0 = c->x, x1 = c->x + c->width + 2 * c->border_width;
+	int y0 = c->y, y1 = c->y + c->height + 2 * c->border_width;
+	Edge vertical[] = { { x0, y0, y1, c->window }, { x1, y0, y1, c->window } };
+	Edge horizontal[] = { { y0, x0, x1, c->window }, { y1, x0, x1, c->window } };
+	Centre centre = { (x0 + x1) / 2, (y0 + y1) / 2, c, c->window };
+
+	if (!sorted) {
+		memcpy(&vertical_edges[edge_count], vertical, sizeof(vertical));
+		memcpy(&horizontal_edges[edge_count], horizontal, sizeof(horizontal));
+		edge_count += 2;
+		centres_by_x[centre_count++] = centre;
+		return;
+	}
+
+	for (size_t i = 0; i < LENGTH(vertical); i++) {
+		insert_edge(vertical_edges, edge_count, vertical[i]);
+		insert_edge(horizontal_edges, edge_count, horizontal[i]);
+		edge_count++;
+	}
+	insert_centre(centres_by_x, centre, true);
+	insert_centre(centres_by_y, centre, false);
+	centre_count++;
+}
+
+// Drops a window's entries, keeping the arrays in order.
+static void remove_window(Window window) {
+	size_t v = 0, h = 0;
+	for (size_t i = 0; i < edge_count; i++) {
+		if (vertical_edges[i].window != window) vertical_edges[v++] = vertical_edges[i];
+		if (horizontal_edges[i].window != window) horizontal_edges[h++] = horizontal_edges[i];
+	}
+	edge_count = v;
+
+	size_t x = 0, y = 0;
+	for (size_t i = 0; i < centre_count; i++) {
+		if (centres_by_x[i].window != window) centres_by_x[x++] = centres_by_x[i];
+		if (centres_by_y[i].window != window) centres_by_y[y++] = centres_by_y[i];
+	}
+	centre_count = x;
+}
+
+static void rebuild(void) {
+	size_t clients = 0;
+	for (Client *c = client_desktop_first(current_desktop); c; c = c->desktop_next) clients++;
+	for (Client *c = client_desktop_first(0); c; c = c->desktop_next) clients++;
+
+	edge_count = 0;
+	centre_count = 0;
+	pending_count = 0;
+	if (!reserve(clients)) return;
+
+	for (Client *c = client_desktop_first(current_desktop); c; c = c->desktop_next) {
+		if (is_visible(c)) add_client(c, false);
+	}
+	for (Client *c = client_desktop_first(0); c; c = c->desktop_next) {
+		if (is_visible(c)) add_client(c, false);
+	}
+
+	qsort(vertical_edges, edge_count, sizeof(Edge), compare_edges);
+	qsort(horizontal_edges, edge_count, sizeof(Edge), compare_edges);
+	memcpy(centres_by_y, centres_by_x, centre_count * sizeof(Centre));
+	qsort(centres_by_x, centre_count, sizeof(Centre), compare_centres_x);
+	qsort(centres_by_y, centre_count, sizeof(Centre), compare_centres_y);
+
+	dirty = false;
+	log_message(stdout, LOG_DEBUG, "Spatial index rebuilt with %lu windows", (unsigned long)centre_count);
+}
+
+// Brings the index up to date before a query. Removed clients are gone from
+// the registry by now, so queued windows are looked up again by id.
+static void update(void) {
+	if (dirty) {
+		rebuild();
+		return;
+	}
+
+	for (size_t i = 0; i < pending_count; i++) {
+		remove_window(pending[i]);
+
+		Client *c = client_find(pending[i]);
+		if (!c || !is_visible(c) || !on_current_desktop(c)) continue;
+		if (!reserve(centre_count + 1)) continue;
+		add_client(c, true);
+	}
+	pending_count = 0;
+}
+
+static bool overlaps(const Edge *edge, int from, int to) {
+	return edge->from < to && edge->to > from;
+}
+
+// Offset that moves `position` onto the closest edge within snap_distance,
+// or `best` when no edge is closer than that. The monitor edges `low` and
+// `high` always count.
+static int closest_offset(const Edge *edges, int position, int from, int to, int low, int high, int best) {
+	int candidates[] = { low, high };
+	for (size_t i = 0; i < LENGTH(candidates); i++) {
+		int offset = candidates[i] - position;
+		if (abs(offset) < abs(best)) best = offset;
+	}
+
+	for (size_t i = lower_bound(edges, edge_count, position - snap_distance); i < edge_count && edges[i].position <= position + snap_distance; i++) {
+		if (!overlaps(&edges[i], from, to)) continue;
+		int offset = edges[i].position - position;
+		if (abs(offset) < abs(best)) best = offset;
+	}
+	return best;
+}
+
+// The edge arrays are looked up after update(), which may reallocate them.
+static int snap(bool vertical, int position, int size, int from, int to, int low, int high) {
+	if (snap_distance == 0) return position;
+	update();
+	const Edge *edges = vertical ? vertical_edges : horizontal_edges;
+
+	// Either side of the window may snap, whichever is closer wins.
+	int none = snap_distance + 1;
+	int offset = closest_offset(edges, position, from, to, low, high, none);
+	offset = closest_offset(edges, position + size, from, to, low, high, offset);
+	return abs(offset) <= snap_distance ? position + offset : position;
+}
+
+// Windows snap to the edges of the monitor holding their centre.
+int spatial_snap_x(int x, int y, int width, int height) {
+	const Geometry *m = monitor_at(x + width / 2, y + height / 2);
+	return snap(true, x, width, y, y + height, m->x, m->x + m->width);
+}
+
+int spatial_snap_y(int x, int y, int width, int height) {
+	const Geometry *m = monitor_at(x + width / 2, y + height / 2);
+	return snap(false, y, height, x, x + width, m->y, m->y + m->height);
+}
+
+// Closest edge strictly before `position` (or after it when `forward` is set)
+// among windows that overlap [from, to], falling back to the monitor edges
+// `low` and `high`.
+static int next_edge(bool vertical, int position, int from, int to, bool forward, int low, int high) {
+	update();
+	const Edge *edges = vertical ? vertical_edges : horizontal_edges;
+
+	size_t i = lower_bound(edges, edge_count, forward ? position + 1 : position);
+	if (forward) {
+		for (; i < edge_count; i++) {
+			if (edges[i].position < high && overlaps(&edges[i], from, to)) return edges[i].position;
+		}
+		return high;
+	}
+
+	while (i-- > 0) {
+		if (edges[i].position > low && overlaps(&edges[i], from, to)) return edges[i].position;
+	}
+	return low;
+}
+
+int spatial_edge_x(const Geometry *monitor, int x, int y, int height, bool forward) {
+	return next_edge(true, x, y, y + height, forward, monitor->x, monitor->x + monitor->width);
+}
+
+int spatial_edge_y(const Geometry *monitor, int y, int x, int width, bool forward) {
+	return next_edge(false, y, x, x + width, forward, monitor->y, monitor->y + monitor->height);
+}
+
+// Walks outwards from the client's own centre along the primary axis. A
+// candidate's score is its distance along that axis plus twice its offset on
+// the other one, and since the score can't be less than the primary distance
+// the walk stops as soon as that distance alone exceeds the best score.
+Client *spatial_neighbour(const Client *from, Direction direction) {
+	update();
+
+	bool horizontal = direction == DIRECTION_LEFT || direction == DIRECTION_RIGHT;
+	bool forward = direction == DIRECTION_RIGHT || direction == DIRECTION_DOWN;
+	const Centre *centres = horizontal ? centres_by_x : centres_by_y;
+
+	int x0 = from->x, x1 = from->x + from->width + 2 * from->border_width;
+	int y0 = from->y, y1 = from->y + from->height + 2 * from->border_width;
+	int cx = (x0 + x1) / 2, cy = (y0 + y1) / 2;
+	int primary = horizontal ? cx : cy;
+
+	// First centre past the client's own in the walking direction.
+	size_t low = 0, high = centre_count;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		int value = horizontal ? centres[mid].x : centres[mid].y;
+		if (forward ? value <= primary : value < primary) low = mid + 1;
+		else high = mid;
+	}
+
+	Client *best = NULL;
+	long best_score = 0;
+	for (size_t step = 0; step < centre_count; step++) {
+		size_t i;
+		if (forward) {
+			i = low + step;
+			if (i >= centre_count) break;
+		} else {
+			if (step >= low) break;
+			i = low - 1 - step;
+		}
+
+		const Centre *candidate = &centres[i];
+		long distance = labs((long)(horizontal ? candidate->x - cx : candidate->y - cy));
+		if (best && distance >= best_score) break;
+		if (candidate->client == from || distance == 0) continue;
+
+		long score = distance + 2 * labs((long)(horizontal ? candidate->y - cy : candidate->x - cx));
+		if (!best || score < best_score) {
+			best = candidate->client;
+			best_score = score;
+		}
+	}
+
+	return best;
+}
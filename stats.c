@@ -0,0 +1,125 @@
+#include <stdio.h>
+
+#include "plusminus.h"
+
+// Per event type latency histograms. Handler times are recorded in log-linear
+// buckets: values below 8ns get a bucket each, every power of two above that
+// is split into 8 sub-buckets, so any percentile is reported within 12.5% of
+// the real value while the whole table stays a fixed size. Counts, the exact
+// maximum and the total are kept alongside.
+
+#define STATS_SUB_BUCKETS 8
+#define STATS_BUCKETS ((64 - 2) * STATS_SUB_BUCKETS)
+
+typedef struct {
+	unsigned long count;
+	long long total;
+	long long max;
+	unsigned int buckets[STATS_BUCKETS];
+} EventStats;
+
+static EventStats stats[LASTEvent];
+
+static const char *event_names[LASTEvent] = {
+	[KeyPress] = "KeyPress",
+	[KeyRelease] = "KeyRelease",
+	[ButtonPress] = "ButtonPress",
+	[ButtonRelease] = "ButtonRelease",
+	[MotionNotify] = "MotionNotify",
+	[EnterNotify] = "EnterNotify",
+	[LeaveNotify] = "LeaveNotify",
+	[FocusIn] = "FocusIn",
+	[FocusOut] = "FocusOut",
+	[KeymapNotify] = "KeymapNotify",
+	[Expose] = "Expose",
+	[GraphicsExpose] = "GraphicsExpose",
+	[NoExpose] = "NoExpose",
+	[VisibilityNotify] = "VisibilityNotify",
+	[CreateNotify] = "CreateNotify",
+	[DestroyNotify] = "DestroyNotify",
+	[UnmapNotify] = "UnmapNotify",
+	[MapNotify] = "MapNotify",
+	[MapRequest] = "MapRequest",
+	[ReparentNotify] = "ReparentNotify",
+	[ConfigureNotify] = "ConfigureNotify",
+	[ConfigureRequest] = "ConfigureRequest",
+	[GravityNotify] = "GravityNotify",
+	[ResizeRequest] = "ResizeRequest",
+	[CirculateNotify] = "CirculateNotify",
+	[CirculateRequest] = "CirculateRequest",
+	[PropertyNotify] = "PropertyNotify",
+	[SelectionClear] = "SelectionClear",
+	[SelectionRequest] = "SelectionRequest",
+	[SelectionNotify] = "SelectionNotify",
+	[ColormapNotify] = "ColormapNotify",
+	[ClientMessage] = "ClientMessage",
+	[MappingNotify] = "MappingNotify",
+	[GenericEvent] = "GenericEvent",
+};
+
+static unsigned int bucket_index(unsigned long long ns) {
+	if (ns < STATS_SUB_BUCKETS) return (unsigned int)ns;
+
+	unsigned int msb = 0;
+	for (unsigned long long v = ns; v >>= 1;) msb++;
+
+	unsigned int sub = (unsigned int)(ns >> (msb - 3)) & (STATS_SUB_BUCKETS - 1);
+	return (msb - 2) * STATS_SUB_BUCKETS + sub;
+}
+
+// Upper edge of a bucket, used when reporting percentiles.
+static long long bucket_limit(unsigned int index) {
+	if (index < STATS_SUB_BUCKETS) return index;
+
+	unsigned int msb = index / STATS_SUB_BUCKETS + 2;
+	unsigned long long sub = index % STATS_SUB_BUCKETS;
+	return (long long)(((STATS_SUB_BUCKETS + sub + 1) << (msb - 3)) - 1);
+}
+
+static long long percentile(const EventStats *s, unsigned int permille) {
+	unsigned long rank = (s->count * permille + 999) / 1000;
+	if (rank == 0) rank = 1;
+
+	unsigned long seen = 0;
+	for (unsigned int i = 0; i < STATS_BUCKETS; i++) {
+		seen += s->buckets[i];
+		if (seen >= rank) {
+			long long limit = bucket_limit(i);
+			return limit < s->max ? limit : s->max;
+		}
+	}
+	return s->max;
+}
+
+const char *stats_event_name(int type) {
+	if (type < 0 || type >= LASTEvent || !event_names[type]) return "unknown";
+	return event_names[type];
+}
+
+void stats_record(int type, long long ns) {
+	if (type < 0 || type >= LASTEvent) return;
+	if (ns < 0) ns = 0;
+
+	EventStats *s = &stats[type];
+	s->count++;
+	s->total += ns;
+	if (ns > s->max) s->max = ns;
+	s->buckets[bucket_index((unsigned long long)ns)]++;
+}
+
+void stats_dump(void) {
+	log_message(stdout, LOG_INFO, "%-18s %10s %10s %10s %10s %10s", "event", "count", "mean(us)", "p50(us)", "p99(us)", "max(us)");
+
+	for (int type = 0; type < LASTEvent; type++) {
+		const EventStats *s = &stats[type];
+		if (s->count == 0) continue;
+
+		log_message(stdout, LOG_INFO, "%-18s %10lu %10.1f %10.1f %10.1f %10.1f",
+				stats_event_name(type),
+				s->count,
+				s->total / 1000.0 / s->count,
+				percentile(s, 500) / 1000.0,
+				percentile(s, 990) / 1000.0,
+				s->max / 1000.0);
+	}
+}
@@ -0,0 +1,182 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "plusminus.h"
+
+// Status bar widgets. Each widget refreshes on its own interval and every
+// interval is aligned to multiples of itself since the epoch, so widgets with
+// related intervals wake up together and the WM sleeps in between. The /proc
+// widgets keep their files open and re-read them with pread into fixed
+// buffers; nothing here allocates after startup.
+
+#define MAX_WIDGETS 16
+#define PROC_BUFFER_SIZE 4096
+
+typedef struct {
+	const Widget *widget;
+	unsigned int interval;
+	time_t next_due;
+	int segment;
+} ScheduledWidget;
+
+static ScheduledWidget scheduled[MAX_WIDGETS];
+static size_t scheduled_count = 0;
+
+static const char *clock_format = "%H:%M";
+static char proc_buffer[PROC_BUFFER_SIZE];
+
+// Returns the interval the clock needs to stay accurate: every second if the
+// format shows seconds, otherwise on every minute.
+static unsigned int time_format_interval(const char *format) {
+	for (const char *p = format; *p; p++) {
+		if (*p != '%' || !p[1]) continue;
+		p++;
+		if (*p == 'E' || *p == 'O') p++;
+		if (strchr("ScsTrX+", *p)) return 1;
+	}
+	return 60;
+}
+
+void widgets_init(const Widget *widgets, size_t count, const char *time_format) {
+	clock_format = time_format;
+
+	if (count > MAX_WIDGETS) {
+		log_message(stderr, LOG_WARNING, "Only the first %d widgets are used", MAX_WIDGETS);
+		count = MAX_WIDGETS;
+	}
+
+	// Segments are laid out right to left, so add them in reverse to keep the
+	// configured order on screen.
+	for (size_t i = count; i-- > 0;) {
+		ScheduledWidget *s = &scheduled[scheduled_count++];
+		s->widget = &widgets[i];
+		s->interval = widgets[i].interval;
+		if (s->interval == 0) {
+			s->interval = widgets[i].func == widget_time ? time_format_interval(time_format) : 1;
+		}
+		s->next_due = 0;
+		s->segment = bar_add_segment(false);
+	}
+}
+
+void widgets_update(time_t now) {
+	bool updated = false;
+
+	for (size_t i = 0; i < scheduled_count; i++) {
+		ScheduledWidget *s = &scheduled[i];
+
+		// The wall clock went backwards, don't wait for the old deadline.
+		if (s->next_due > now + (time_t)s->interval) s->next_due = now;
+		if (s->next_due > now) continue;
+
+		char text[64];
+		if (!s->widget->func(text, sizeof(text))) text[0] = '\0';
+		bar_set_segment(s->segment, text);
+		s->next_due = (now / s->interval + 1) * s->interval;
+		updated = true;
+	}
+
+	if (updated) bar_render();
+}
+
+time_t widgets_next_wakeup(void) {
+	time_t next = 0;
+	for (size_t i = 0; i < scheduled_count; i++) {
+		if (next == 0 || scheduled[i].next_due < next) {
+			next = scheduled[i].next_due;
+		}
+	}
+	return next;
+}
+
+static ssize_t read_proc(int *fd, const char *path) {
+	if (*fd == -1) {
+		*fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (*fd == -1) {
+			log_message(stderr, LOG_WARNING, "Failed to open %s", path);
+			return -1;
+		}
+	}
+
+	ssize_t n = pread(*fd, proc_buffer, sizeof(proc_buffer) - 1, 0);
+	if (n < 0) return -1;
+	proc_buffer[n] = '\0';
+	return n;
+}
+
+static unsigned long long parse_number(const char **p) {
+	while (**p == ' ' || **p == '\t') (*p)++;
+	unsigned long long value = 0;
+	while (**p >= '0' && **p <= '9') {
+		value = value * 10 + (unsigned long long)(**p - '0');
+		(*p)++;
+	}
+	return value;
+}
+
+bool widget_time(char *text, size_t size) {
+	time_t now = time(NULL);
+	struct tm *tm_info = localtime(&now);
+	return strftime(text, size, clock_format, tm_info) > 0;
+}
+
+bool widget_cpu(char *text, size_t size) {
+	static int fd = -1;
+	static unsigned long long last_total = 0, last_idle = 0;
+
+	if (read_proc(&fd, "/proc/stat") < 5 || strncmp(proc_buffer, "cpu ", 4) != 0) return false;
+
+	// cpu  user nice system idle iowait irq softirq steal
+	const char *p = proc_buffer + 4;
+	unsigned long long fields[8];
+	for (int i = 0; i < 8; i++) {
+		fields[i] = parse_number(&p);
+	}
+
+	unsigned long long idle = fields[3] + fields[4];
+	unsigned long long total = 0;
+	for (int i = 0; i < 8; i++) {
+		total += fields[i];
+	}
+
+	unsigned long long total_delta = total - last_total;
+	unsigned long long idle_delta = idle - last_idle;
+	last_total = total;
+	last_idle = idle;
+
+	unsigned int usage = total_delta ? (unsigned int)(100 * (total_delta - idle_delta) / total_delta) : 0;
+	snprintf(text, size, "CPU %u%%", usage);
+	return true;
+}
+
+bool widget_memory(char *text, size_t size) {
+	static int fd = -1;
+
+	if (read_proc(&fd, "/proc/meminfo") <= 0) return false;
+
+	unsigned long long total = 0, available = 0;
+	for (const char *p = proc_buffer; *p; ) {
+		if (strncmp(p, "MemTotal:", 9) == 0) {
+			p += 9;
+			total = parse_number(&p);
+		} else if (strncmp(p, "MemAvailable:", 13) == 0) {
+			p += 13;
+			available = parse_number(&p);
+		}
+
+		if (total && available) break;
+		while (*p && *p != '\n') p++;
+		if (*p) p++;
+	}
+
+	if (total == 0) return false;
+
+	unsigned int usage = (unsigned int)(100 * (total - available) / total);
+	snprintf(text, size, "MEM %u%%", usage);
+	return true;
+}